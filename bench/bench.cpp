@@ -3,18 +3,32 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <numeric>
 #include <random>
 #include <sstream>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <lockfree-queue/mpmc.h>
+#include <lockfree-queue/mpmc_numa.h>
+#include <lockfree-queue/mpmc_partitioned.h>
 #include <lockfree-queue/mpsc.h>
+#include <lockfree-queue/mpsc_lanes.h>
 #include <lockfree-queue/mpsc_pc.h>
+#include <lockfree-queue/mpsc_unbounded.h>
+#include <lockfree-queue/spsc.h>
 
 #include "Barrier.h"
 #include "waitevent.h"
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 
 #ifndef _MSC_VER
 #define sscanf_s(...) std::sscanf(__VA_ARGS__)
@@ -26,9 +40,35 @@ template <typename T> struct CQueueBase
 {
 	virtual ~CQueueBase() = default;
 
-	virtual auto TryPush(int pid, const T& val) noexcept -> std::optional<T> = 0;
+	virtual auto TryPush(int pid, const T& val) noexcept -> bool = 0;
 	virtual auto TryPop(int pid) noexcept -> std::optional<T> = 0;
 
+	virtual auto TryPushN(int pid, const T* vals, std::size_t count) noexcept -> std::size_t
+	{
+		std::size_t i = 0;
+		while (i < count && TryPush(pid, vals[i]))
+			i++;
+		return i;
+	}
+	virtual auto TryPopN(int pid, T* vals, std::size_t count) noexcept -> std::size_t
+	{
+		std::size_t i = 0;
+		for (; i < count; i++)
+		{
+			auto val = TryPop(pid);
+			if (!val)
+				break;
+			vals[i] = *val;
+		}
+		return i;
+	}
+
+	// Publishes the pushes a producer deferred, if any.
+	virtual void Flush(int /*pid*/) noexcept {}
+
+	// Prints the queue's own counters, if any.
+	virtual void PrintStats() {}
+
 	virtual auto IsFull() noexcept -> bool = 0;
 	virtual auto IsEmpty() noexcept -> bool = 0;
 };
@@ -40,11 +80,21 @@ public:
 
 	explicit CQueue(std::shared_ptr<CQueueBase<T>> queue) : m_queue(std::move(queue)) {}
 
-	auto TryPush(int pid, const T& val) noexcept -> std::optional<T>
+	auto TryPush(int pid, const T& val) noexcept -> bool { return m_queue->TryPush(pid, val); }
+	auto TryPop(int pid) noexcept -> std::optional<T> { return m_queue->TryPop(pid); }
+
+	auto TryPushN(int pid, const T* vals, std::size_t count) noexcept -> std::size_t
 	{
-		return m_queue->TryPush(pid, val);
+		return m_queue->TryPushN(pid, vals, count);
+	}
+	auto TryPopN(int pid, T* vals, std::size_t count) noexcept -> std::size_t
+	{
+		return m_queue->TryPopN(pid, vals, count);
 	}
-	auto TryPop(int pid) noexcept -> std::optional<T> { return m_queue->TryPop(pid); }
+
+	void Flush(int pid) noexcept { m_queue->Flush(pid); }
+
+	void PrintStats() { m_queue->PrintStats(); }
 
 	auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
 	auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
@@ -58,7 +108,8 @@ template <typename T> class Bench
 public:
 	explicit Bench(CQueue<T> queue) : m_queue(std::move(queue)) {}
 
-	auto start(std::size_t num_times, int num_producers, int num_consumers, bool verify) -> int
+	auto start(std::size_t num_times, int num_producers, int num_consumers,
+		std::size_t batch_size, bool verify) -> int
 	{
 		Barrier start_bench_barrier;
 		auto& queue = m_queue;
@@ -66,10 +117,10 @@ public:
 		auto producers_we = std::make_shared<WaitEvent>();
 		auto consumers_we = std::make_shared<WaitEvent>();
 
-		auto [producers, input] = start_producers(queue, num_producers, 0, num_times, producers_we,
-			consumers_we, cout_sync_m, start_bench_barrier);
-		auto [consumers, output] = start_consumers(std::move(queue), num_consumers, num_producers,
-			num_producers * num_times, producers_we, consumers_we, cout_sync_m,
+		auto [producers, input] = start_producers(queue, num_producers, 0, num_times, batch_size,
+			producers_we, consumers_we, cout_sync_m, start_bench_barrier);
+		auto [consumers, output] = start_consumers(queue, num_consumers, num_producers,
+			num_producers * num_times, batch_size, producers_we, consumers_we, cout_sync_m,
 			start_bench_barrier);
 
 		auto start = std::chrono::system_clock::now();
@@ -115,6 +166,118 @@ public:
 		std::chrono::duration<double> elapsed_seconds = end - start;
 
 		std::cout << "elapsed time: " << elapsed_seconds.count() << "s\n";
+		std::cout << "throughput: "
+				  << static_cast<double>(num_times * num_producers) / elapsed_seconds.count()
+				  << " items/s\n";
+		m_queue.PrintStats();
+		return 0;
+	}
+
+	// Single producer pushes timestamps, one every `interval`, and the consumer measures how late
+	// it pops them. `num_stallers` more producers keep pushing at the lowest priority, so that they
+	// are often descheduled in the middle of a push.
+	auto latency(std::size_t num_times, std::chrono::nanoseconds interval, int num_stallers = 0)
+		-> int
+	{
+		using clock = std::chrono::steady_clock;
+
+		auto now = [] {
+			return static_cast<T>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				clock::now().time_since_epoch())
+									  .count());
+		};
+
+		std::vector<T> latencies;
+		latencies.reserve(num_times);
+
+		std::thread producer([&] {
+			auto next = clock::now();
+
+			for (std::size_t i = 0; i < num_times; i++)
+			{
+				while (clock::now() < next)
+					std::this_thread::yield();
+
+				while (!m_queue.TryPush(0, now()))
+					std::this_thread::yield();
+
+				next += interval;
+			}
+
+			m_queue.Flush(0);
+		});
+
+		std::atomic<bool> done = false;
+		std::vector<std::thread> stallers;
+
+		for (int pid = 1; pid <= num_stallers; pid++)
+		{
+			stallers.emplace_back([&, pid] {
+				lower_priority();
+
+				while (!done.load(std::memory_order_relaxed))
+				{
+					if (!m_queue.TryPush(pid, 0))
+						std::this_thread::yield();
+				}
+
+				m_queue.Flush(pid);
+			});
+		}
+
+		while (latencies.size() < num_times)
+		{
+			// Stallers push zeros, which are never timestamps.
+			if (auto ts = m_queue.TryPop(num_stallers + 1))
+			{
+				if (*ts != 0)
+					latencies.push_back(now() - *ts);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		done = true;
+		producer.join();
+		for (auto& staller : stallers)
+			staller.join();
+
+		std::sort(latencies.begin(), latencies.end());
+
+		const auto sum = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+		const auto percentile = [&](double p) {
+			return latencies[static_cast<std::size_t>(p * static_cast<double>(num_times - 1))];
+		};
+
+		std::cout << "latency mean: " << sum / static_cast<double>(num_times) << "ns\n";
+		std::cout << "latency p50: " << percentile(0.5) << "ns\n";
+		std::cout << "latency p99: " << percentile(0.99) << "ns\n";
+		std::cout << "latency p99.99: " << percentile(0.9999) << "ns\n";
+		std::cout << "latency max: " << latencies.back() << "ns\n";
+		m_queue.PrintStats();
+		return 0;
+	}
+
+	// Consumer polls the empty queue, while the producers are idle.
+	auto empty_poll(std::size_t num_times, int pid) -> int
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		for (std::size_t i = 0; i < num_times; i++)
+		{
+			if (m_queue.TryPop(pid))
+			{
+				std::cerr << "Queue has problem\n";
+				return 1;
+			}
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed =
+			std::chrono::steady_clock::now() - start;
+
+		std::cout << "empty poll: " << elapsed.count() / static_cast<double>(num_times) << "ns\n";
 		return 0;
 	}
 
@@ -126,6 +289,7 @@ private:
 		std::shared_ptr<std::vector<T>> out;
 		std::shared_ptr<std::atomic<std::size_t>> num_consumed;
 		std::size_t total_items;
+		std::size_t batch_size;
 		std::shared_ptr<WaitEvent> producers;
 		std::shared_ptr<WaitEvent> consumers;
 
@@ -138,6 +302,7 @@ private:
 		CQueue<T> queue;
 		int pid;
 		std::shared_ptr<std::vector<T>> in;
+		std::size_t batch_size;
 		std::shared_ptr<WaitEvent> producers;
 		std::shared_ptr<WaitEvent> consumers;
 
@@ -149,6 +314,7 @@ private:
 	{
 		std::size_t num_times_waited = 0;
 		std::size_t local_consumed = 0;
+		std::vector<T> batch(cdata.batch_size);
 
 		std::move(cdata.start_bench_barrier).Wait();
 
@@ -161,11 +327,11 @@ private:
 
 		while (cdata.num_consumed->load() < cdata.total_items)
 		{
-			if (auto val = cdata.queue.TryPop(cdata.pid))
+			if (auto count = cdata.queue.TryPopN(cdata.pid, batch.data(), batch.size()))
 			{
-				cdata.out->emplace_back(*val);
+				cdata.out->insert(cdata.out->end(), batch.begin(), batch.begin() + count);
 				cdata.producers->WakeupOneWaiter();
-				local_consumed++;
+				local_consumed += count;
 			}
 			else
 			{
@@ -194,17 +360,25 @@ private:
 
 		auto pred = [&pdata] { return !pdata.queue.IsFull(); };
 
-		for (auto elem : *pdata.in)
+		const auto& in = *pdata.in;
+
+		for (std::size_t i = 0; i < in.size();)
 		{
-			while (!pdata.queue.TryPush(pdata.pid, elem))
+			const auto count = std::min(pdata.batch_size, in.size() - i);
+
+			if (auto pushed = pdata.queue.TryPushN(pdata.pid, in.data() + i, count))
+			{
+				i += pushed;
+				pdata.consumers->WakeupOneWaiter();
+			}
+			else
 			{
 				adaptive_wait(pred, *pdata.producers);
 				num_times_waited++;
 			}
-
-			pdata.consumers->WakeupOneWaiter();
 		}
 
+		pdata.queue.Flush(pdata.pid);
 		pdata.consumers->WakeupAllWaiters();
 
 		{
@@ -214,7 +388,8 @@ private:
 	}
 
 	static auto start_consumers(CQueue<T> queue, int num_consumers, int pid_start,
-		std::size_t total_items, const std::shared_ptr<WaitEvent>& producers_we,
+		std::size_t total_items, std::size_t batch_size,
+		const std::shared_ptr<WaitEvent>& producers_we,
 		const std::shared_ptr<WaitEvent>& consumers_we,
 		const std::shared_ptr<std::mutex>& cout_sync_m, const Barrier& start_bench_barrier)
 		-> std::pair<std::vector<std::thread>, std::vector<std::shared_ptr<std::vector<T>>>>
@@ -223,7 +398,7 @@ private:
 		std::vector<std::shared_ptr<std::vector<T>>> output;
 
 		auto num_consumed = std::make_shared<std::atomic<std::size_t>>(0);
-		ConsumerData cdata_base = { std::move(queue), 0, {}, num_consumed, total_items,
+		ConsumerData cdata_base = { std::move(queue), 0, {}, num_consumed, total_items, batch_size,
 			producers_we, consumers_we, cout_sync_m, start_bench_barrier };
 
 		for (int i = 0; i < num_consumers; i++)
@@ -258,14 +433,15 @@ private:
 	}
 
 	static auto start_producers(CQueue<T> queue, int num_producers, int pid_start,
-		std::size_t num_items, const std::shared_ptr<WaitEvent>& producers_we,
+		std::size_t num_items, std::size_t batch_size,
+		const std::shared_ptr<WaitEvent>& producers_we,
 		const std::shared_ptr<WaitEvent>& consumers_we,
 		const std::shared_ptr<std::mutex>& cout_sync_m, const Barrier& start_bench_barrier)
 		-> std::pair<std::vector<std::thread>, std::vector<std::shared_ptr<std::vector<T>>>>
 	{
 		std::vector<std::thread> threads;
 		std::vector<std::shared_ptr<std::vector<T>>> input;
-		ProducerData pdata_base = { std::move(queue), 0, {}, producers_we, consumers_we,
+		ProducerData pdata_base = { std::move(queue), 0, {}, batch_size, producers_we, consumers_we,
 			cout_sync_m, start_bench_barrier };
 
 		for (int i = 0; i < num_producers; i++)
@@ -283,6 +459,15 @@ private:
 		return { std::move(threads), std::move(input) };
 	}
 
+	// Lets every other thread preempt the calling one.
+	static void lower_priority() noexcept
+	{
+#ifdef __linux__
+		sched_param param{};
+		pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+	}
+
 	template <typename Predicate> static void adaptive_wait(Predicate&& predicate, WaitEvent& we)
 	{
 		auto available = [&] {
@@ -307,13 +492,51 @@ private:
 };
 
 
-template <typename T> struct MPMCQueueWrapper : public CQueueBase<T>
+template <typename T, typename Capacity, typename Layout = lockfree::DenseLayout>
+struct MPMCQueueWrapper : public CQueueBase<T>
 {
-	MPMCQueueWrapper(int max_processes, std::size_t queue_size) : queue(max_processes, queue_size)
+	// When `combined`, producers push through the flat combiner.
+	MPMCQueueWrapper(int max_processes, std::size_t queue_size, bool combined = false)
+		: queue(max_processes, queue_size), combined(combined)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
 	{
+		return combined ? queue.TryPushCombined(pid, val) : queue.TryPush(pid, val);
 	}
+	auto TryPop(int pid) noexcept -> std::optional<T> override { return queue.TryPop(pid); }
 
-	auto TryPush(int pid, const T& val) noexcept -> std::optional<T> override
+	auto TryPushN(int pid, const T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		if (combined)
+			return CQueueBase<T>::TryPushN(pid, vals, count);
+		return queue.TryPushN(pid, vals, count);
+	}
+	auto TryPopN(int pid, T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPopN(pid, vals, count);
+	}
+
+	auto IsFull() noexcept -> bool override { return queue.IsFull(); }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPMCQueue<T, Capacity, Layout> queue;
+	bool combined;
+};
+
+template <typename T, typename Capacity>
+using MPMCPaddedQueueWrapper = MPMCQueueWrapper<T, Capacity, lockfree::PaddedLayout>;
+
+template <typename T, typename Capacity> struct MPMCSeqQueueWrapper : public CQueueBase<T>
+{
+	MPMCSeqQueueWrapper(int max_processes, std::size_t queue_size)
+		: queue(max_processes, queue_size)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
 	{
 		return queue.TryPush(pid, val);
 	}
@@ -323,16 +546,229 @@ template <typename T> struct MPMCQueueWrapper : public CQueueBase<T>
 	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
 
 private:
-	MPMCQueue<T> queue;
+	MPMCSeqQueue<T, Capacity> queue;
 };
 
-template <typename T> struct MPSCQueueWrapper : public CQueueBase<T>
+template <typename T, typename Capacity> struct MPMCWaitFreeQueueWrapper : public CQueueBase<T>
 {
-	MPSCQueueWrapper(int max_processes, std::size_t queue_size) : queue(max_processes, queue_size)
+	MPMCWaitFreeQueueWrapper(int max_processes, std::size_t queue_size)
+		: queue(max_processes, queue_size)
 	{
 	}
 
-	auto TryPush(int pid, const T& val) noexcept -> std::optional<T> override
+	auto TryPush(int pid, const T& val) noexcept -> bool override
+	{
+		return queue.TryPush(pid, val);
+	}
+	auto TryPop(int pid) noexcept -> std::optional<T> override { return queue.TryPop(pid); }
+
+	auto TryPushN(int pid, const T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPushN(pid, vals, count);
+	}
+	auto TryPopN(int pid, T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPopN(pid, vals, count);
+	}
+
+	auto IsFull() noexcept -> bool override { return queue.IsFull(); }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPMCWaitFreeQueue<T, Capacity> queue;
+};
+
+// `queue_size` is the size of a node's shard.
+template <typename T, typename Capacity> struct MPMCNumaQueueWrapper : public CQueueBase<T>
+{
+	MPMCNumaQueueWrapper(int max_processes, std::size_t queue_size)
+		: queue(max_processes, queue_size)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
+	{
+		return queue.TryPush(pid, val);
+	}
+	auto TryPop(int pid) noexcept -> std::optional<T> override { return queue.TryPop(pid); }
+
+	void PrintStats() override { std::cout << "numa nodes: " << queue.NumNodes() << "\n"; }
+
+	auto IsFull() noexcept -> bool override { return queue.IsFull(); }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPMCNumaQueue<T, Capacity> queue;
+};
+
+// Items are their own key, and there are `PARTITIONS_PER_CONSUMER` partitions of `queue_size`
+// elements per consumer. Consumers are numbered from their pid, which follows the producers'.
+template <typename T, typename Capacity> struct MPMCPartitionedQueueWrapper : public CQueueBase<T>
+{
+	static constexpr int PARTITIONS_PER_CONSUMER = 4;
+
+	MPMCPartitionedQueueWrapper(
+		int max_processes, std::size_t queue_size, int num_producers, int num_consumers)
+		: queue(max_processes, num_consumers * PARTITIONS_PER_CONSUMER, queue_size, num_consumers),
+		  num_producers(num_producers)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
+	{
+		return queue.TryPush(pid, val, val);
+	}
+	auto TryPop(int pid) noexcept -> std::optional<T> override
+	{
+		return queue.TryPop(pid - num_producers);
+	}
+
+	void PrintStats() override
+	{
+		std::cout << "partition depths:";
+		for (int p = 0; p < queue.NumPartitions(); p++)
+			std::cout << " " << queue.Depth(p);
+		std::cout << "\n";
+	}
+
+	// Partitions fill independently.
+	auto IsFull() noexcept -> bool override { return false; }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPMCPartitionedQueue<T, Capacity> queue;
+	int num_producers;
+};
+
+// Items travel inline as variable size elements of `sizeof(T)` bytes.
+template <typename T, typename Capacity> struct MPMCQueueAnyWrapper : public CQueueBase<T>
+{
+	MPMCQueueAnyWrapper(int max_processes, std::size_t queue_size)
+		: queue(max_processes, lockfree::Framing{}.ElemEnd(0, sizeof(T)) * queue_size)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
+	{
+		return queue.TryPush(pid, &val, sizeof(T));
+	}
+	auto TryPop(int pid) noexcept -> std::optional<T> override
+	{
+		T val;
+		if (queue.TryPop(pid, &val, sizeof(T)))
+			return val;
+		return {};
+	}
+
+	auto IsFull() noexcept -> bool override { return queue.IsFull(); }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPMCQueueAny queue;
+};
+
+template <typename T, typename Capacity, typename Layout = lockfree::DenseLayout>
+struct MPSCQueueWrapper : public CQueueBase<T>
+{
+	// When `combined`, producers push through the flat combiner.
+	MPSCQueueWrapper(int max_processes, std::size_t queue_size, bool combined = false)
+		: queue(max_processes, queue_size), combined(combined)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
+	{
+		return combined ? queue.TryPushCombined(pid, val) : queue.TryPush(pid, val);
+	}
+	auto TryPop(int /*pid*/) noexcept -> std::optional<T> override { return queue.TryPop(); }
+
+	auto TryPushN(int pid, const T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		if (combined)
+			return CQueueBase<T>::TryPushN(pid, vals, count);
+		return queue.TryPushN(pid, vals, count);
+	}
+	auto TryPopN(int /*pid*/, T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPopN(vals, count);
+	}
+
+	auto IsFull() noexcept -> bool override { return queue.IsFull(); }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPSCQueue<T, Capacity, Layout> queue;
+	bool combined;
+};
+
+template <typename T, typename Capacity>
+using MPSCPaddedQueueWrapper = MPSCQueueWrapper<T, Capacity, lockfree::PaddedLayout>;
+
+// Consumer skips the pushes, which stalled in the middle.
+template <typename T, typename Capacity> struct MPSCUnorderedQueueWrapper : public CQueueBase<T>
+{
+	MPSCUnorderedQueueWrapper(int max_processes, std::size_t queue_size)
+		: queue(max_processes, queue_size)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
+	{
+		return queue.TryPush(pid, val);
+	}
+	auto TryPop(int /*pid*/) noexcept -> std::optional<T> override
+	{
+		return queue.TryPopUnordered();
+	}
+
+	auto TryPushN(int pid, const T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPushN(pid, vals, count);
+	}
+
+	auto IsFull() noexcept -> bool override { return queue.IsFull(); }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPSCQueue<T, Capacity> queue;
+};
+
+// `queue_size` is the size of a segment.
+template <typename T, typename Capacity> struct MPSCUnboundedQueueWrapper : public CQueueBase<T>
+{
+	MPSCUnboundedQueueWrapper(int max_processes, std::size_t queue_size)
+		: queue(max_processes, queue_size)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
+	{
+		queue.Push(pid, val);
+		return true;
+	}
+	auto TryPop(int /*pid*/) noexcept -> std::optional<T> override { return queue.TryPop(); }
+
+	void PrintStats() override
+	{
+		std::cout << "segment allocations: " << queue.SegmentAllocations() << "\n";
+		std::cout << "memory high-water: " << queue.MemoryHighWater() << " bytes\n";
+	}
+
+	auto IsFull() noexcept -> bool override { return false; }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPSCUnboundedQueue<T, Capacity> queue;
+};
+
+template <typename T, typename Capacity> struct MPSCSeqQueueWrapper : public CQueueBase<T>
+{
+	MPSCSeqQueueWrapper(int max_processes, std::size_t queue_size)
+		: queue(max_processes, queue_size)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
 	{
 		return queue.TryPush(pid, val);
 	}
@@ -342,17 +778,48 @@ template <typename T> struct MPSCQueueWrapper : public CQueueBase<T>
 	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
 
 private:
-	MPSCQueue<T> queue;
+	MPSCSeqQueue<T, Capacity> queue;
 };
 
-template <typename T> struct MPSCPCQueueWrapper : public CQueueBase<T>
+// `queue_size` is the size of a producer's lane.
+template <typename T, typename Capacity> struct MPSCLaneQueueWrapper : public CQueueBase<T>
+{
+	MPSCLaneQueueWrapper(int max_processes, std::size_t queue_size)
+		: queue(max_processes, queue_size)
+	{
+	}
+
+	auto TryPush(int pid, const T& val) noexcept -> bool override
+	{
+		return queue.TryPush(pid, val);
+	}
+	auto TryPop(int /*pid*/) noexcept -> std::optional<T> override { return queue.TryPop(); }
+
+	auto TryPushN(int pid, const T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPushN(pid, vals, count);
+	}
+	auto TryPopN(int /*pid*/, T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPopN(vals, count);
+	}
+
+	// Every lane holds all the items of its producer.
+	auto IsFull() noexcept -> bool override { return false; }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	MPSCLaneQueue<T, Capacity> queue;
+};
+
+template <typename T, typename Capacity> struct MPSCPCQueueWrapper : public CQueueBase<T>
 {
 	MPSCPCQueueWrapper(int /*max_processes*/, std::size_t queue_size)
-		: queue((sizeof(MPSCPCQueueAny::size_type) + sizeof(T)) * queue_size)
+		: queue(ring_size((sizeof(MPSCPCQueueAny::size_type) + sizeof(T)) * queue_size))
 	{
 	}
 
-	auto TryPush(int /*pid*/, const T& val) noexcept -> std::optional<T> override
+	auto TryPush(int /*pid*/, const T& val) noexcept -> bool override
 	{
 		return queue.TryPush(reinterpret_cast<const char*>(&val), sizeof(T));
 	}
@@ -368,47 +835,201 @@ template <typename T> struct MPSCPCQueueWrapper : public CQueueBase<T>
 	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
 
 private:
+	// MPSCPCQueueAny picks the mask or modulo path by itself, based on the ring size.
+	static auto ring_size(std::size_t size) noexcept -> std::size_t
+	{
+		if constexpr (std::is_same_v<Capacity, lockfree::PowerOfTwoCapacity>)
+			return lockfree::PowerOfTwoCapacity::RoundUp(size);
+		else
+			return size;
+	}
+
 	MPSCPCQueueAny queue;
 };
 
+template <typename T, typename Capacity> struct SPSCQueueWrapper : public CQueueBase<T>
+{
+	SPSCQueueWrapper(int /*max_processes*/, std::size_t queue_size, std::size_t publish_batch = 1)
+		: queue(queue_size, publish_batch)
+	{
+	}
+
+	auto TryPush(int /*pid*/, const T& val) noexcept -> bool override
+	{
+		return queue.TryPush(val);
+	}
+	auto TryPop(int /*pid*/) noexcept -> std::optional<T> override { return queue.TryPop(); }
+
+	auto TryPushN(int /*pid*/, const T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPushN(vals, count);
+	}
+	auto TryPopN(int /*pid*/, T* vals, std::size_t count) noexcept -> std::size_t override
+	{
+		return queue.TryPopN(vals, count);
+	}
+
+	void Flush(int /*pid*/) noexcept override { queue.Flush(); }
+
+	auto IsFull() noexcept -> bool override { return queue.IsFull(); }
+	auto IsEmpty() noexcept -> bool override { return queue.IsEmpty(); }
+
+private:
+	SPSCQueue<T, Capacity> queue;
+};
+
+template <template <typename, typename> typename Wrapper, typename T, typename... Args>
+auto make_queue(bool pow2, int max_processes, std::size_t queue_size, const Args&... args)
+	-> CQueue<T>
+{
+	if (pow2)
+	{
+		return CQueue<T>(std::make_shared<Wrapper<T, lockfree::PowerOfTwoCapacity>>(
+			max_processes, lockfree::PowerOfTwoCapacity::RoundUp(queue_size), args...));
+	}
+	return CQueue<T>(std::make_shared<Wrapper<T, lockfree::ArbitraryCapacity>>(
+		max_processes, queue_size, args...));
+}
+
 auto main(int argc, char** argv) -> int
 {
 	auto print_help = [&] {
 		std::cerr
 			<< "Usage: " << argv[0]
-			<< " queue_type[= mpmc/mpsc/mpsc-pc] num_items num_producers num_consumers [verify]\n";
+			<< " queue_type[= mpmc/mpmc-seq/mpmc-wf/mpmc-any/mpmc-numa/mpmc-partitioned/"
+			   "mpsc/mpsc-unordered/mpsc-unbounded/mpsc-seq/mpsc-lanes/mpsc-pc/spsc]"
+			   "[-padded][-fc][-pow2][-latency/-stall/-empty] num_items "
+			   "num_producers num_consumers [verify] [batch_size] [publish_batch] "
+			   "[max_processes]\n";
 	};
-	if (argc != 5 && argc != 6)
+	if (argc < 5 || argc > 9)
 	{
 		print_help();
 		return -1;
 	}
 
 	constexpr std::string_view MPMC = "mpmc";
+	constexpr std::string_view MPMC_SEQ = "mpmc-seq";
+	constexpr std::string_view MPMC_WAIT_FREE = "mpmc-wf";
+	constexpr std::string_view MPMC_ANY = "mpmc-any";
+	constexpr std::string_view MPMC_NUMA = "mpmc-numa";
+	constexpr std::string_view MPMC_PARTITIONED = "mpmc-partitioned";
 	constexpr std::string_view MPSC = "mpsc";
+	constexpr std::string_view MPSC_UNORDERED = "mpsc-unordered";
+	constexpr std::string_view MPSC_UNBOUNDED = "mpsc-unbounded";
+	constexpr std::string_view MPSC_SEQ = "mpsc-seq";
+	constexpr std::string_view MPSC_LANES = "mpsc-lanes";
 	constexpr std::string_view MPSC_PC = "mpsc-pc";
+	constexpr std::string_view SPSC = "spsc";
+	constexpr std::string_view POW2_SUFFIX = "-pow2";
+	constexpr std::string_view COMBINED_SUFFIX = "-fc";
+	constexpr std::string_view PADDED_SUFFIX = "-padded";
+	constexpr std::string_view LATENCY_SUFFIX = "-latency";
+	constexpr std::string_view STALL_SUFFIX = "-stall";
+	constexpr std::string_view EMPTY_SUFFIX = "-empty";
+	constexpr auto LATENCY_INTERVAL = std::chrono::microseconds(1);
+	constexpr std::size_t UNBOUNDED_SEGMENT_SIZE = 1024;
 
 	std::string queue_type;
 	std::size_t num_times;
 	int num_producers;
 	int num_consumers;
 	bool verify = false;
+	std::size_t batch_size = 1;
+	std::size_t publish_batch = 1;
+	int max_processes = 0;
 
 	std::istringstream(argv[1]) >> queue_type;
 	std::istringstream(argv[2]) >> num_times;
 	std::istringstream(argv[3]) >> num_producers;
 	std::istringstream(argv[4]) >> num_consumers;
 
-	if (argc == 6)
+	if (argc >= 6)
 		std::istringstream(argv[5]) >> std::boolalpha >> verify;
+	if (argc >= 7)
+		std::istringstream(argv[6]) >> batch_size;
+	if (argc >= 8)
+		std::istringstream(argv[7]) >> publish_batch;
+	if (argc == 9)
+		std::istringstream(argv[8]) >> max_processes;
+
+	batch_size = std::max<std::size_t>(batch_size, 1);
+	publish_batch = std::max<std::size_t>(publish_batch, 1);
+
+	auto strip_suffix = [&queue_type](std::string_view suffix) {
+		if (queue_type.size() > suffix.size() &&
+			std::string_view(queue_type).substr(queue_type.size() - suffix.size()) == suffix)
+		{
+			queue_type.resize(queue_type.size() - suffix.size());
+			return true;
+		}
+		return false;
+	};
+
+	// "-latency" measures the delay of single items, pushed at a steady pace, instead of the
+	// throughput.
+	const bool latency = strip_suffix(LATENCY_SUFFIX);
+	// "-stall" measures the latency too, while the other producers are descheduled in the middle
+	// of their pushes.
+	const bool stall = !latency && strip_suffix(STALL_SUFFIX);
+	// "-empty" measures a consumer polling the empty queue, which must check the idle producers.
+	const bool empty = !latency && !stall && strip_suffix(EMPTY_SUFFIX);
+	// "-pow2" rounds the capacity up to a power of two, so that positions are wrapped using a mask.
+	const bool pow2 = strip_suffix(POW2_SUFFIX);
+	// "-fc" makes the producers of mpmc and mpsc push through the flat combiner.
+	const bool combined = strip_suffix(COMBINED_SUFFIX);
+	// "-padded" stores every element of mpmc and mpsc on a cache line of its own.
+	const bool padded = strip_suffix(PADDED_SUFFIX);
+
+	if (latency)
+	{
+		num_producers = 1;
+		num_consumers = 1;
+	}
+	if (stall)
+		num_consumers = 1;
+
+	// Queues can be sized for more processes than the ones running, to measure the cost of the idle
+	// ones.
+	auto processes = [&] { return std::max(max_processes, num_producers + num_consumers); };
 
 	using T = std::uint64_t;
 	std::optional<CQueue<T>> queue;
 
 	if (queue_type == MPMC)
 	{
-		queue.emplace(std::make_shared<MPMCQueueWrapper<T>>(
-			num_producers + num_consumers, num_producers * num_times));
+		queue.emplace(padded
+				? make_queue<MPMCPaddedQueueWrapper, T>(
+					  pow2, processes(), num_producers * num_times, combined)
+				: make_queue<MPMCQueueWrapper, T>(
+					  pow2, processes(), num_producers * num_times, combined));
+	}
+	else if (queue_type == MPMC_SEQ)
+	{
+		queue.emplace(make_queue<MPMCSeqQueueWrapper, T>(
+			pow2, processes(), num_producers * num_times));
+	}
+	else if (queue_type == MPMC_WAIT_FREE)
+	{
+		queue.emplace(make_queue<MPMCWaitFreeQueueWrapper, T>(
+			pow2, processes(), num_producers * num_times));
+	}
+	else if (queue_type == MPMC_ANY)
+	{
+		queue.emplace(make_queue<MPMCQueueAnyWrapper, T>(
+			pow2, processes(), num_producers * num_times));
+	}
+	else if (queue_type == MPMC_NUMA)
+	{
+		// Every shard can hold all the items, as producers may all run on one node.
+		queue.emplace(make_queue<MPMCNumaQueueWrapper, T>(
+			pow2, processes(), num_producers * num_times));
+	}
+	else if (queue_type == MPMC_PARTITIONED)
+	{
+		// Every partition can hold all the items, as the keys may all hash to one.
+		queue.emplace(make_queue<MPMCPartitionedQueueWrapper, T>(
+			pow2, processes(), num_producers * num_times, num_producers, num_consumers));
 	}
 	else if (queue_type == MPSC)
 	{
@@ -418,8 +1039,56 @@ auto main(int argc, char** argv) -> int
 						 "one consumer.\n";
 		}
 		num_consumers = 1;
-		queue.emplace(std::make_shared<MPSCQueueWrapper<T>>(
-			num_producers + num_consumers, num_producers * num_times));
+		queue.emplace(padded
+				? make_queue<MPSCPaddedQueueWrapper, T>(
+					  pow2, processes(), num_producers * num_times, combined)
+				: make_queue<MPSCQueueWrapper, T>(
+					  pow2, processes(), num_producers * num_times, combined));
+	}
+	else if (queue_type == MPSC_UNORDERED)
+	{
+		if (num_consumers != 1)
+		{
+			std::cerr << "WARNING: MPSC queue will have only one consumer. Running MPSC bench with "
+						 "one consumer.\n";
+		}
+		num_consumers = 1;
+		queue.emplace(make_queue<MPSCUnorderedQueueWrapper, T>(
+			pow2, processes(), num_producers * num_times));
+	}
+	else if (queue_type == MPSC_UNBOUNDED)
+	{
+		if (num_consumers != 1)
+		{
+			std::cerr << "WARNING: MPSC queue will have only one consumer. Running MPSC bench with "
+						 "one consumer.\n";
+		}
+		num_consumers = 1;
+		queue.emplace(make_queue<MPSCUnboundedQueueWrapper, T>(
+			pow2, processes(), UNBOUNDED_SEGMENT_SIZE));
+	}
+	else if (queue_type == MPSC_SEQ)
+	{
+		if (num_consumers != 1)
+		{
+			std::cerr
+				<< "WARNING: MPSC-SEQ queue will have only one consumer. Running MPSC bench with "
+				   "one consumer.\n";
+		}
+		num_consumers = 1;
+		queue.emplace(make_queue<MPSCSeqQueueWrapper, T>(
+			pow2, processes(), num_producers * num_times));
+	}
+	else if (queue_type == MPSC_LANES)
+	{
+		if (num_consumers != 1)
+		{
+			std::cerr
+				<< "WARNING: MPSC-LANES queue will have only one consumer. Running MPSC bench with "
+				   "one consumer.\n";
+		}
+		num_consumers = 1;
+		queue.emplace(make_queue<MPSCLaneQueueWrapper, T>(pow2, processes(), num_times));
 	}
 	else if (queue_type == MPSC_PC)
 	{
@@ -430,8 +1099,20 @@ auto main(int argc, char** argv) -> int
 				   "one consumer.\n";
 		}
 		num_consumers = 1;
-		queue.emplace(std::make_shared<MPSCPCQueueWrapper<T>>(
-			num_producers + num_consumers, num_producers * num_times));
+		queue.emplace(make_queue<MPSCPCQueueWrapper, T>(
+			pow2, processes(), num_producers * num_times));
+	}
+	else if (queue_type == SPSC)
+	{
+		if (num_producers != 1 || num_consumers != 1)
+		{
+			std::cerr << "WARNING: SPSC queue will have only one producer and one consumer. "
+						 "Running SPSC bench with one producer and one consumer.\n";
+		}
+		num_producers = 1;
+		num_consumers = 1;
+		queue.emplace(make_queue<SPSCQueueWrapper, T>(
+			pow2, processes(), num_producers * num_times, publish_batch));
 	}
 	else
 	{
@@ -439,5 +1120,14 @@ auto main(int argc, char** argv) -> int
 		return 1;
 	}
 
-	return Bench(*std::move(queue)).start(num_times, num_producers, num_consumers, verify);
+	if (latency || stall)
+	{
+		return Bench(*std::move(queue))
+			.latency(num_times, LATENCY_INTERVAL, stall ? num_producers - 1 : 0);
+	}
+	if (empty)
+		return Bench(*std::move(queue)).empty_poll(num_times, num_producers);
+
+	return Bench(*std::move(queue))
+		.start(num_times, num_producers, num_consumers, batch_size, verify);
 }
\ No newline at end of file
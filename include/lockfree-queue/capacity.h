@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+namespace lockfree
+{
+	// Capacity policies map the ever increasing head/tail positions of a queue to offsets inside
+	// its ring buffer.
+
+	// Capacity can be anything. Positions are wrapped using modulo.
+	class ArbitraryCapacity
+	{
+	public:
+		using size_type = std::size_t;
+
+		explicit ArbitraryCapacity(size_type capacity) noexcept : m_capacity(capacity) {}
+
+		[[nodiscard]] auto Size() const noexcept -> size_type { return m_capacity; }
+		[[nodiscard]] auto Wrap(size_type pos) const noexcept -> size_type
+		{
+			return pos % m_capacity;
+		}
+
+	private:
+		size_type m_capacity;
+	};
+
+	// Capacity must be a power of two. Positions are wrapped using a mask.
+	class PowerOfTwoCapacity
+	{
+	public:
+		using size_type = std::size_t;
+
+		static constexpr auto IsValid(size_type capacity) noexcept -> bool
+		{
+			return capacity != 0 && (capacity & (capacity - 1)) == 0;
+		}
+
+		static constexpr auto RoundUp(size_type capacity) noexcept -> size_type
+		{
+			size_type res = 1;
+			while (res < capacity)
+				res <<= 1U;
+			return res;
+		}
+
+		explicit PowerOfTwoCapacity(size_type capacity) noexcept : m_mask(capacity - 1)
+		{
+			assert(IsValid(capacity));
+		}
+
+		[[nodiscard]] auto Size() const noexcept -> size_type { return m_mask + 1; }
+		[[nodiscard]] auto Wrap(size_type pos) const noexcept -> size_type { return pos & m_mask; }
+
+	private:
+		size_type m_mask;
+	};
+
+	// Capacity is the compile time constant `N`, so that wrapping needs no load and is folded into
+	// a mask, when `N` is a power of two.
+	template <std::size_t N> class FixedCapacity
+	{
+		static_assert(N != 0, "Capacity must not be zero");
+
+	public:
+		using size_type = std::size_t;
+
+		explicit FixedCapacity([[maybe_unused]] size_type capacity) noexcept
+		{
+			assert(capacity == N);
+		}
+
+		[[nodiscard]] static constexpr auto Size() noexcept -> size_type { return N; }
+		[[nodiscard]] static constexpr auto Wrap(size_type pos) noexcept -> size_type
+		{
+			return pos % N;
+		}
+	};
+
+	// Chosen when the queue is initialized. Positions are wrapped using a mask, if the capacity is
+	// a power of two, and using modulo otherwise.
+	class DynamicCapacity
+	{
+	public:
+		using size_type = std::size_t;
+
+		explicit DynamicCapacity(size_type capacity) noexcept
+			: m_capacity(capacity),
+			  m_mask(PowerOfTwoCapacity::IsValid(capacity) ? capacity - 1 : NO_MASK)
+		{
+		}
+
+		[[nodiscard]] auto Size() const noexcept -> size_type { return m_capacity; }
+		[[nodiscard]] auto Wrap(size_type pos) const noexcept -> size_type
+		{
+			return m_mask != NO_MASK ? pos & m_mask : pos % m_capacity;
+		}
+
+		[[nodiscard]] auto IsPowerOfTwo() const noexcept -> bool { return m_mask != NO_MASK; }
+
+	private:
+		static constexpr auto NO_MASK = ~size_type{ 0 };
+
+		size_type m_capacity;
+		size_type m_mask;
+	};
+}
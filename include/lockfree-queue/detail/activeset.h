@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "lockfree-queue/detail/defs.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace lockfree::detail
+{
+	// Bitmap of the processes, which are in the middle of reserving a queue position. Scans of the
+	// processes' positions visit only those, instead of every process. Every word is on its own
+	// cache line, so that only processes sharing a word contend on it.
+	struct alignas(CACHELINESIZE) ActiveWord
+	{
+		std::atomic<std::uint64_t> bits = 0;
+	};
+
+	static constexpr int ACTIVE_WORD_BITS = 64;
+
+	// Upto this many processes, scanning all the positions is cheaper than maintaining the bitmap.
+	static constexpr int ACTIVE_SET_MIN_PROCESSES = 16;
+
+	constexpr auto use_active_set(int max_processes) noexcept -> bool
+	{
+		return max_processes > ACTIVE_SET_MIN_PROCESSES;
+	}
+
+	constexpr auto active_set_words(int max_processes) noexcept -> int
+	{
+		return use_active_set(max_processes)
+			? (max_processes + ACTIVE_WORD_BITS - 1) / ACTIVE_WORD_BITS
+			: 0;
+	}
+
+	constexpr auto active_set_size(int max_processes) noexcept -> std::size_t
+	{
+		return sizeof(ActiveWord) * active_set_words(max_processes);
+	}
+
+	inline void init_active_set(ActiveWord* set, int max_processes) noexcept
+	{
+		for (int i = 0; i < active_set_words(max_processes); i++)
+			new (&set[i]) ActiveWord{};
+	}
+
+	// Must be set before the process publishes its position, and cleared after it resets it.
+	inline void set_active(ActiveWord* set, int max_processes, int pid) noexcept
+	{
+		if (use_active_set(max_processes))
+		{
+			set[pid / ACTIVE_WORD_BITS].bits.fetch_or(std::uint64_t{ 1 }
+				<< (pid % ACTIVE_WORD_BITS));
+		}
+	}
+	inline void clear_active(ActiveWord* set, int max_processes, int pid) noexcept
+	{
+		if (use_active_set(max_processes))
+		{
+			set[pid / ACTIVE_WORD_BITS].bits.fetch_and(
+				~(std::uint64_t{ 1 } << (pid % ACTIVE_WORD_BITS)), std::memory_order_release);
+		}
+	}
+
+	inline auto count_trailing_zeros(std::uint64_t bits) noexcept -> int
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+
+	// Calls `fn(pid)` for every process, which may be active. That's every process, if the set
+	// isn't used for `max_processes`.
+	template <typename Fn>
+	inline void for_each_active(const ActiveWord* set, int max_processes, Fn&& fn)
+	{
+		if (!use_active_set(max_processes))
+		{
+			for (int i = 0; i < max_processes; i++)
+				fn(i);
+			return;
+		}
+
+		for (int w = 0; w < active_set_words(max_processes); w++)
+		{
+			for (auto bits = load_acquire(set[w].bits); bits != 0; bits &= bits - 1)
+				fn(w * ACTIVE_WORD_BITS + count_trailing_zeros(bits));
+		}
+	}
+}
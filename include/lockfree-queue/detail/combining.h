@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+#include <thread>
+
+#include "lockfree-queue/detail/defs.h"
+
+namespace lockfree::detail
+{
+	// Flat combining of pushes. Producers publish their element in their own slot, and whoever
+	// holds the combiner role pushes all the published elements as one batch, so that the head is
+	// updated once for the lot.
+
+	enum class CombineState : std::uint8_t
+	{
+		EMPTY,
+		PENDING,
+		DONE,
+		FAILED, // Queue was full.
+	};
+
+	// One per process, in an array of its own after the queue, so that only `TryPushCombined`
+	// touches it. Only its owner and the combiner write it.
+	template <typename T> struct alignas(std::max(CACHELINESIZE, alignof(T))) CombineSlot
+	{
+		std::atomic<CombineState> state = CombineState::EMPTY;
+		T value;
+	};
+
+	// Elements are gathered into batches of upto this many, on the combiner's stack.
+	static constexpr std::size_t COMBINE_BATCH = 64;
+
+	// Pauses, while waiting for the combiner, before yielding instead. A combiner finishes a batch
+	// within microseconds, so a waiter never sleeps.
+	static constexpr int COMBINE_SPINS = 128;
+
+	// `get_slot(pid)` returns the slot of `pid`. `push_n(vals, count)` pushes upto `count` elements
+	// and returns the number pushed. Returns false, if the queue was full.
+	template <typename T, typename GetSlot, typename PushN>
+	auto combine_push(std::atomic<bool>& combining, int max_processes, int pid, const T& val,
+		GetSlot&& get_slot, PushN&& push_n) noexcept -> bool
+	{
+		auto& slot = get_slot(pid);
+		int spins = 0;
+
+		slot.value = val;
+		store_release(slot.state, CombineState::PENDING);
+
+		for (;;)
+		{
+			if (auto state = load_acquire(slot.state); state != CombineState::PENDING)
+			{
+				slot.state.store(CombineState::EMPTY, std::memory_order_relaxed);
+				return state == CombineState::DONE;
+			}
+
+			if (!load_relaxed(combining) && !combining.exchange(true, std::memory_order_acquire))
+			{
+				std::array<T, COMBINE_BATCH> vals;
+				std::array<int, COMBINE_BATCH> pids;
+				std::size_t count = 0;
+
+				auto flush = [&] {
+					const auto pushed = push_n(vals.data(), count);
+
+					for (std::size_t i = 0; i < count; i++)
+					{
+						store_release(get_slot(pids[i]).state,
+							i < pushed ? CombineState::DONE : CombineState::FAILED);
+					}
+					count = 0;
+				};
+
+				for (int i = 0; i < max_processes; i++)
+				{
+					auto& other = get_slot(i);
+
+					if (load_acquire(other.state) == CombineState::PENDING)
+					{
+						vals[count] = other.value;
+						pids[count++] = i;
+
+						if (count == COMBINE_BATCH)
+							flush();
+					}
+				}
+
+				if (count != 0)
+					flush();
+
+				combining.store(false, std::memory_order_release);
+				continue;
+			}
+
+			if (spins < COMBINE_SPINS)
+			{
+				spins++;
+				_mm_pause();
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "lockfree-queue/detail/defs.h"
+
+namespace lockfree::detail
+{
+	// Wait-free taking of credits. Credits are granted by moving a bound, and taken by moving the
+	// count of credits taken towards it with a CAS, so that the count never overshoots the bound.
+	// A process, whose CAS keeps failing, announces a request for one credit in its own
+	// `CreditRequest`, and the other processes take it on its behalf, before taking their own.
+	//
+	// Count word has the credits taken so far in its low `CREDIT_TAKEN_BITS` bits, and the
+	// process, for which the last credit was taken, plus one, in the rest. Until the credit is
+	// handed to the process's request, and the process cleared from the word, no one else can
+	// take credits. If the request was failed meanwhile, the credit is given back.
+
+	enum class CreditState : std::uint64_t
+	{
+		IDLE,
+		PENDING,
+		DONE,
+		FAILED, // No credit was left.
+	};
+
+	// Lives in a process's `ThreadPos`.
+	struct CreditRequest
+	{
+		std::atomic<std::uint64_t> word = 0; // Sequence number of the request, and its state.
+		int next_help = 0;					 // Owned by the process.
+	};
+
+	static constexpr int CREDIT_TAKEN_BITS = 48;
+	static constexpr std::uint64_t CREDIT_TAKEN_MASK =
+		(std::uint64_t{ 1 } << CREDIT_TAKEN_BITS) - 1;
+
+	// Failed CAS attempts, before a process asks for help.
+	static constexpr int CREDIT_PATIENCE = 4;
+
+	// `get_request(pid)` returns the request of `pid`, and `granted()` the current bound.
+	template <typename GetRequest, typename Granted> class CreditPool
+	{
+	public:
+		using size_type = std::size_t;
+
+		CreditPool(std::atomic<std::uint64_t>& taken, int max_processes, GetRequest get_request,
+			Granted granted) noexcept
+			: m_taken(taken), m_max_processes(max_processes),
+			  m_get_request(std::move(get_request)), m_granted(std::move(granted))
+		{
+		}
+
+		// Takes upto `count` credits for `pid`. Returns 0, only if no credit was left at some
+		// point during the call.
+		auto Take(int pid, size_type count) noexcept -> size_type
+		{
+			help_next(pid);
+
+			for (int i = 0; i < CREDIT_PATIENCE; i++)
+			{
+				auto word = load_acquire(m_taken);
+
+				if (owner(word) != NO_OWNER)
+				{
+					complete(word);
+					continue;
+				}
+
+				const auto avail = available(word);
+				if (avail == 0)
+					return 0;
+
+				const auto got = std::min(count, avail);
+				if (m_taken.compare_exchange_strong(word, make_word(taken(word) + got, NO_OWNER)))
+					return got;
+			}
+
+			return take_slow(pid);
+		}
+
+		// Only a hint, while the credits are being taken.
+		auto Available() noexcept -> size_type { return available(load_acquire(m_taken)); }
+
+	private:
+		static constexpr int NO_OWNER = -1;
+		static constexpr int STATE_BITS = 2;
+
+		static auto make_word(std::uint64_t taken, int owner) noexcept -> std::uint64_t
+		{
+			return (taken & CREDIT_TAKEN_MASK) | std::uint64_t(owner + 1) << CREDIT_TAKEN_BITS;
+		}
+		static auto taken(std::uint64_t word) noexcept -> std::uint64_t
+		{
+			return word & CREDIT_TAKEN_MASK;
+		}
+		static auto owner(std::uint64_t word) noexcept -> int
+		{
+			return int(word >> CREDIT_TAKEN_BITS) - 1;
+		}
+
+		static auto make_request(std::uint64_t seq, CreditState state) noexcept -> std::uint64_t
+		{
+			return seq << STATE_BITS | std::uint64_t(state);
+		}
+		static auto request_seq(std::uint64_t req) noexcept -> std::uint64_t
+		{
+			return req >> STATE_BITS;
+		}
+		static auto request_state(std::uint64_t req) noexcept -> CreditState
+		{
+			return CreditState(req & ((std::uint64_t{ 1 } << STATE_BITS) - 1));
+		}
+
+		// Bound is read after the count, so it can only be larger than when the count was.
+		auto available(std::uint64_t word) noexcept -> size_type
+		{
+			return (m_granted() - taken(word)) & CREDIT_TAKEN_MASK;
+		}
+
+		// Processes take turns in helping every other process, one per call.
+		void help_next(int pid) noexcept
+		{
+			auto& next = m_get_request(pid).next_help;
+			const auto other = next;
+
+			next = (next + 1) % m_max_processes;
+			if (other != pid &&
+				request_state(load_acquire(m_get_request(other).word)) == CreditState::PENDING)
+			{
+				help(other);
+			}
+		}
+
+		auto take_slow(int pid) noexcept -> size_type
+		{
+			auto& req = m_get_request(pid);
+			const auto seq = request_seq(load_relaxed(req.word)) + 1;
+
+			req.word.store(make_request(seq, CreditState::PENDING));
+			help(pid);
+
+			// Our credit must be cleared from the count, before we ask for another one.
+			if (auto word = load_acquire(m_taken); owner(word) == pid)
+				complete(word);
+
+			return request_state(load_acquire(req.word)) == CreditState::DONE ? 1 : 0;
+		}
+
+		// Takes a credit for the request of `pid`, until it is done or failed. Every failed CAS
+		// is another process's progress, and the processes help `pid` once they get to it, so
+		// this is bounded too.
+		void help(int pid) noexcept
+		{
+			auto& req = m_get_request(pid);
+
+			for (;;)
+			{
+				// Count is read before the request, so that the credit isn't taken for a request,
+				// which was done meanwhile.
+				auto word = load_acquire(m_taken);
+				auto reqword = load_acquire(req.word);
+
+				if (request_state(reqword) != CreditState::PENDING)
+					return;
+
+				if (owner(word) != NO_OWNER)
+				{
+					complete(word);
+				}
+				else if (available(word) == 0)
+				{
+					req.word.compare_exchange_strong(
+						reqword, make_request(request_seq(reqword), CreditState::FAILED));
+				}
+				else if (const auto next = make_word(taken(word) + 1, pid);
+						 m_taken.compare_exchange_strong(word, next))
+				{
+					complete(next);
+				}
+			}
+		}
+
+		// Hands the credit taken in `word` to its owner's request, and clears the owner.
+		void complete(std::uint64_t word) noexcept
+		{
+			auto& req = m_get_request(owner(word));
+
+			for (;;)
+			{
+				auto reqword = load_acquire(req.word);
+				if (load_acquire(m_taken) != word)
+					return;
+
+				auto cleared = make_word(taken(word), NO_OWNER);
+
+				switch (request_state(reqword))
+				{
+				case CreditState::PENDING:
+					req.word.compare_exchange_strong(
+						reqword, make_request(request_seq(reqword), CreditState::DONE));
+					continue;
+
+				case CreditState::DONE:
+					break;
+
+				default:
+					// Request was failed by a process, which found no credit left.
+					cleared = make_word(taken(word) - 1, NO_OWNER);
+					break;
+				}
+
+				m_taken.compare_exchange_strong(word, cleared);
+				return;
+			}
+		}
+
+
+		std::atomic<std::uint64_t>& m_taken;
+		const int m_max_processes;
+		GetRequest m_get_request;
+		Granted m_granted;
+	};
+}
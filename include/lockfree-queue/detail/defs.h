@@ -4,6 +4,7 @@
 #include <boost/align/aligned_alloc.hpp>
 #include <functional>
 #include <memory>
+#include <new>
 
 namespace lockfree::detail
 {
@@ -19,6 +20,11 @@ namespace lockfree::detail
 		return aval.load(std::memory_order_acquire);
 	}
 
+	template <typename T> static inline auto load_relaxed(const std::atomic<T>& aval) noexcept -> T
+	{
+		return aval.load(std::memory_order_relaxed);
+	}
+
 	template <typename T, typename... InitArgs>
 	inline auto MakeAndInitialize(InitArgs&&... initargs) -> std::shared_ptr<T>
 	{
@@ -28,10 +34,49 @@ namespace lockfree::detail
 
 		std::unique_ptr<void, decltype(deleter)> uninit_mem(
 			boost::alignment::aligned_alloc(alignof(T), size), deleter);
-		std::unique_ptr<T, decltype(deleter)> mem(
-			T::Initialize(uninit_mem.get(), std::forward<InitArgs>(initargs)...), deleter);
+		std::unique_ptr<T, void (*)(T*)> mem(
+			T::Initialize(uninit_mem.get(), std::forward<InitArgs>(initargs)...), [](T* p) {
+				std::destroy_at(p);
+				boost::alignment::aligned_free(p);
+			});
 		(void)uninit_mem.release(); // `mem` is now the sole owner.
 
 		return mem;
 	}
+
+	// Layout of a queue, whose ring buffers are mapped twice back to back in virtual memory, so
+	// that an element crossing the end of a ring buffer continues into its mirror. The mapping is
+	// made of `num_rings` blocks, each of `header_size` bytes followed by the ring buffer and its
+	// mirror of `ring_size` bytes. Both sizes must be multiples of `page_size()`. The queue object
+	// is placed at `object_offset` in the first block.
+	struct MirroredLayout
+	{
+		std::size_t header_size;
+		std::size_t ring_size;
+		std::size_t num_rings;
+		std::size_t object_offset;
+	};
+
+	auto page_size() noexcept -> std::size_t;
+
+	// Returns nullptr, if the mapping cannot be created.
+	auto map_mirrored(const MirroredLayout& layout) noexcept -> void*;
+	void unmap_mirrored(void* mem, const MirroredLayout& layout) noexcept;
+
+	template <typename T, typename... InitArgs>
+	inline auto MakeAndInitializeMirrored(const InitArgs&... initargs) -> std::shared_ptr<T>
+	{
+		const auto layout = T::CalculateMirroredLayout(initargs...);
+		auto* mem = map_mirrored(layout);
+
+		if (mem == nullptr)
+			throw std::bad_alloc();
+
+		return std::shared_ptr<T>(
+			T::InitializeMirrored(static_cast<char*>(mem) + layout.object_offset, initargs...),
+			[mem, layout](T* queue) {
+				std::destroy_at(queue);
+				unmap_mirrored(mem, layout);
+			});
+	}
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace lockfree::detail
+{
+	// NUMA topology, as reported by `/sys/devices/system/node`. When it can't be read, the system
+	// is taken to be a single node 0.
+	// Nodes are the online nodes, numbered from 0 in the order of their kernel ids, which may have
+	// gaps, so that they can index an array.
+
+	auto numa_num_nodes() noexcept -> int;
+
+	// Node of the cpu the calling thread runs on.
+	auto numa_current_node() noexcept -> int;
+
+	// Page aligned memory, whose pages are placed on `node`'s memory if possible, and elsewhere
+	// otherwise. `node` must be less than `numa_num_nodes()`. Returns nullptr, if the memory
+	// cannot be mapped.
+	auto numa_alloc_onnode(std::size_t size, int node) noexcept -> void*;
+	void numa_free(void* mem, std::size_t size) noexcept;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+
+#include "lockfree-queue/detail/activeset.h"
+#include "lockfree-queue/detail/defs.h"
+
+namespace lockfree::detail
+{
+	// Bitmap of the pids leased to callers, which don't pick their pids themselves. Leasing is
+	// rare, so the words are packed together.
+	using PidWord = std::atomic<std::uint64_t>;
+
+	constexpr auto pid_set_words(int max_processes) noexcept -> int
+	{
+		return (max_processes + ACTIVE_WORD_BITS - 1) / ACTIVE_WORD_BITS;
+	}
+
+	constexpr auto pid_set_size(int max_processes) noexcept -> std::size_t
+	{
+		return sizeof(PidWord) * pid_set_words(max_processes);
+	}
+
+	inline void init_pid_set(PidWord* set, int max_processes) noexcept
+	{
+		for (int i = 0; i < pid_set_words(max_processes); i++)
+			new (&set[i]) PidWord{ 0 };
+	}
+
+	// Returns nullopt, if all the pids are leased.
+	inline auto acquire_pid(PidWord* set, int max_processes) noexcept -> std::optional<int>
+	{
+		for (int w = 0; w < pid_set_words(max_processes); w++)
+		{
+			const auto nbits = max_processes - w * ACTIVE_WORD_BITS;
+			const auto valid =
+				nbits >= ACTIVE_WORD_BITS ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << nbits) - 1;
+			auto bits = load_relaxed(set[w]);
+
+			while ((~bits & valid) != 0)
+			{
+				const auto pos = count_trailing_zeros(~bits & valid);
+
+				if (set[w].compare_exchange_weak(bits, bits | (std::uint64_t{ 1 } << pos),
+						std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					return w * ACTIVE_WORD_BITS + pos;
+				}
+			}
+		}
+
+		return {};
+	}
+
+	inline void release_pid(PidWord* set, int pid) noexcept
+	{
+		set[pid / ACTIVE_WORD_BITS].fetch_and(
+			~(std::uint64_t{ 1 } << (pid % ACTIVE_WORD_BITS)), std::memory_order_release);
+	}
+}
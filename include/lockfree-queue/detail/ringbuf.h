@@ -1,40 +1,161 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <type_traits>
+
+#include "lockfree-queue/framing.h"
 
 namespace lockfree::detail
 {
-	template <typename size_type>
-	void copy_out_of_ringbuf(
-		const char* rb_base, size_type rb_sz, size_type rb_tail, void* dst, size_type size) noexcept
+	// Region of a ring buffer. When the region wraps around the end of the ring buffer, it is split
+	// into two, with `second` pointing to the start of the ring buffer.
+	template <typename Byte> struct RingBufRegion
 	{
-		rb_tail %= rb_sz;
-		const auto len = std::min(size, rb_sz - rb_tail);
+		Byte* first;
+		std::size_t first_size;
+		Byte* second;
+		std::size_t second_size;
+
+		[[nodiscard]] auto size() const noexcept -> std::size_t { return first_size + second_size; }
+	};
+
+	// `Capacity` is one of the capacity policies in "lockfree-queue/capacity.h". Positions passed
+	// in are unwrapped queue positions. When the ring buffer is mirrored (see
+	// `MakeAndInitializeMirrored`), bytes past its end alias its start, so nothing is split.
+
+	template <typename Byte, typename Capacity, typename size_type = typename Capacity::size_type>
+	auto get_ringbuf_region(Byte* rb_base, const Capacity& rb_cap, bool rb_mirrored,
+		size_type rb_pos, size_type size) noexcept -> RingBufRegion<Byte>
+	{
+		rb_pos = rb_cap.Wrap(rb_pos);
+		const auto len = rb_mirrored ? size : std::min(size, rb_cap.Size() - rb_pos);
+
+		return { rb_base + rb_pos, len, rb_base, size - len };
+	}
+
+	template <typename Capacity, typename size_type = typename Capacity::size_type>
+	void copy_out_of_ringbuf(const char* rb_base, const Capacity& rb_cap, bool rb_mirrored,
+		size_type rb_tail, void* dst, size_type size) noexcept
+	{
+		rb_tail = rb_cap.Wrap(rb_tail);
+		const auto len = rb_mirrored ? size : std::min(size, rb_cap.Size() - rb_tail);
 
 		std::memcpy(dst, rb_base + rb_tail, len);
 		if (len < size)
 			std::memcpy(static_cast<char*>(dst) + len, rb_base, size - len);
 	}
 
-
+	// Copy `src` to the already wrapped offset `rb_off`. Returns the wrapped offset following it.
 	template <typename size_type>
-	void copy_into_ringbuf(
-		char* rb_base, size_type rb_sz, size_type rb_head, const void* src, size_type size) noexcept
+	auto copy_into_ringbuf_at(char* rb_base, size_type rb_sz, bool rb_mirrored, size_type rb_off,
+		const void* src, size_type size) noexcept -> size_type
 	{
-		rb_head %= rb_sz;
-		const auto len = std::min(size, rb_sz - rb_head);
+		const auto len = rb_mirrored ? size : std::min(size, rb_sz - rb_off);
 
-		std::memcpy(rb_base + rb_head, src, len);
+		std::memcpy(rb_base + rb_off, src, len);
 		if (len < size)
+		{
 			std::memcpy(rb_base, static_cast<const char*>(src) + len, size - len);
+			return size - len;
+		}
+
+		return rb_off + len >= rb_sz ? rb_off + len - rb_sz : rb_off + len;
 	}
 
-	template <typename size_type>
-	void copy_elem_into_ringbuf(char* rb_base, size_type rb_sz, size_type rb_head, const void* elem,
-		size_type size) noexcept
+	template <typename Capacity, typename size_type = typename Capacity::size_type>
+	void copy_into_ringbuf(char* rb_base, const Capacity& rb_cap, bool rb_mirrored,
+		size_type rb_head, const void* src, size_type size) noexcept
 	{
-		copy_into_ringbuf(rb_base, rb_sz, rb_head, &size, sizeof(size));
-		copy_into_ringbuf(rb_base, rb_sz, rb_head + sizeof(size), elem, size);
+		copy_into_ringbuf_at(
+			rb_base, rb_cap.Size(), rb_mirrored, rb_cap.Wrap(rb_head), src, size);
+	}
+
+	// Write the length header and the payload of the element framed at `rb_head`. The bounds are
+	// checked once for both and, unless the element crosses the end of the ring buffer, they are
+	// written straight.
+	template <typename Capacity, typename size_type = typename Capacity::size_type>
+	void copy_elem_into_ringbuf(char* rb_base, const Capacity& rb_cap, bool rb_mirrored,
+		const Framing& framing, size_type rb_head, const void* elem, size_type size) noexcept
+	{
+		const auto header_size = framing.HeaderSize();
+		const auto rb_off = rb_cap.Wrap(framing.HeaderPos(rb_head));
+
+		if (rb_mirrored || rb_off + header_size + size <= rb_cap.Size())
+		{
+			auto* p = rb_base + rb_off;
+
+			framing.StoreHeader(p, size);
+			std::memcpy(p + header_size, elem, size);
+			return;
+		}
+
+		char header[sizeof(std::uint64_t)];
+		framing.StoreHeader(header, size);
+
+		const auto payload_off =
+			copy_into_ringbuf_at(rb_base, rb_cap.Size(), false, rb_off, header, header_size);
+		copy_into_ringbuf_at(rb_base, rb_cap.Size(), false, payload_off, elem, size);
+	}
+
+	// Length header of the element framed at `rb_tail`.
+	template <typename Capacity, typename size_type = typename Capacity::size_type>
+	auto read_elem_size(const char* rb_base, const Capacity& rb_cap, bool rb_mirrored,
+		const Framing& framing, size_type rb_tail) noexcept -> size_type
+	{
+		char header[sizeof(std::uint64_t)];
+
+		copy_out_of_ringbuf(rb_base, rb_cap, rb_mirrored, framing.HeaderPos(rb_tail), header,
+			framing.HeaderSize());
+		return framing.LoadHeader(header);
+	}
+
+	// Copies of whole elements, for the queues of `T`, stored as per `Layout`. Positions and counts
+	// are in elements.
+
+	template <typename Layout, typename T, typename Capacity,
+		typename size_type = typename Capacity::size_type>
+	void copy_into_ring(typename Layout::template Slot<T>* ring, const Capacity& cap,
+		size_type pos, const T* src, size_type count) noexcept
+	{
+		pos = cap.Wrap(pos);
+		const auto len = std::min(count, cap.Size() - pos);
+
+		if constexpr (std::is_same_v<typename Layout::template Slot<T>, T>)
+		{
+			std::copy_n(src, len, ring + pos);
+			std::copy_n(src + len, count - len, ring);
+		}
+		else
+		{
+			for (size_type i = 0; i < len; i++)
+				Layout::Value(ring[pos + i]) = src[i];
+			for (size_type i = len; i < count; i++)
+				Layout::Value(ring[i - len]) = src[i];
+		}
+	}
+
+	template <typename Layout, typename T, typename Capacity,
+		typename size_type = typename Capacity::size_type>
+	void copy_out_of_ring(const typename Layout::template Slot<T>* ring, const Capacity& cap,
+		size_type pos, T* dst, size_type count) noexcept
+	{
+		pos = cap.Wrap(pos);
+		const auto len = std::min(count, cap.Size() - pos);
+
+		if constexpr (std::is_same_v<typename Layout::template Slot<T>, T>)
+		{
+			std::copy_n(ring + pos, len, dst);
+			std::copy_n(ring, count - len, dst + len);
+		}
+		else
+		{
+			for (size_type i = 0; i < len; i++)
+				dst[i] = Layout::Value(ring[pos + i]);
+			for (size_type i = len; i < count; i++)
+				dst[i] = Layout::Value(ring[i - len]);
+		}
 	}
-}
\ No newline at end of file
+}
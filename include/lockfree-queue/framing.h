@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace lockfree
+{
+	// Framing of the elements of the variable size (*Any) queues. Every element is a length header
+	// immediately followed by its payload. When payloads are aligned, padding is skipped before
+	// the header, so that the payload starts at a multiple of the alignment. Ring buffer's size
+	// must be a multiple of the alignment.
+	class Framing
+	{
+	public:
+		using size_type = std::size_t;
+
+		enum class Header : std::uint8_t
+		{
+			U32 = sizeof(std::uint32_t),
+			U64 = sizeof(std::uint64_t),
+		};
+
+		// 64-bit header and unaligned payloads.
+		constexpr Framing() noexcept = default;
+
+		// `payload_alignment` must be a power of two, no larger than a cache line.
+		constexpr explicit Framing(Header header, size_type payload_alignment = 1) noexcept
+			: m_header_size(static_cast<size_type>(header)), m_align_mask(payload_alignment - 1)
+		{
+			assert(payload_alignment != 0 && (payload_alignment & m_align_mask) == 0);
+			assert(payload_alignment <= 64);
+		}
+
+		[[nodiscard]] constexpr auto HeaderSize() const noexcept -> size_type
+		{
+			return m_header_size;
+		}
+		[[nodiscard]] constexpr auto PayloadAlignment() const noexcept -> size_type
+		{
+			return m_align_mask + 1;
+		}
+		[[nodiscard]] constexpr auto MaxElemSize() const noexcept -> size_type
+		{
+			return m_header_size == sizeof(std::uint32_t)
+				? std::numeric_limits<std::uint32_t>::max()
+				: std::numeric_limits<size_type>::max();
+		}
+
+		// Positions of the element starting at queue position `pos`.
+		[[nodiscard]] constexpr auto PayloadPos(size_type pos) const noexcept -> size_type
+		{
+			return (pos + m_header_size + m_align_mask) & ~m_align_mask;
+		}
+		[[nodiscard]] constexpr auto HeaderPos(size_type pos) const noexcept -> size_type
+		{
+			return PayloadPos(pos) - m_header_size;
+		}
+		[[nodiscard]] constexpr auto ElemEnd(size_type pos, size_type size) const noexcept
+			-> size_type
+		{
+			return PayloadPos(pos) + size;
+		}
+
+		void StoreHeader(void* dst, size_type size) const noexcept
+		{
+			assert(size <= MaxElemSize());
+
+			if (m_header_size == sizeof(std::uint32_t))
+			{
+				const auto header = static_cast<std::uint32_t>(size);
+				std::memcpy(dst, &header, sizeof(header));
+			}
+			else
+			{
+				const auto header = static_cast<std::uint64_t>(size);
+				std::memcpy(dst, &header, sizeof(header));
+			}
+		}
+
+		[[nodiscard]] auto LoadHeader(const void* src) const noexcept -> size_type
+		{
+			if (m_header_size == sizeof(std::uint32_t))
+			{
+				std::uint32_t header;
+				std::memcpy(&header, src, sizeof(header));
+				return header;
+			}
+
+			std::uint64_t header;
+			std::memcpy(&header, src, sizeof(header));
+			return header;
+		}
+
+	private:
+		size_type m_header_size = sizeof(std::uint64_t);
+		size_type m_align_mask = 0;
+	};
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "lockfree-queue/detail/defs.h"
+
+namespace lockfree
+{
+	// Layout policies decide how the elements of the queues of `T` are stored in their ring buffer.
+	// Each ring buffer entry is a `Slot<T>`, whose element is accessed through `Value`.
+
+	// Elements are stored back to back. Processes working on neighbouring positions, may share a
+	// cache line.
+	struct DenseLayout
+	{
+		template <typename T> using Slot = T;
+
+		template <typename T> static constexpr auto Value(T& slot) noexcept -> T& { return slot; }
+	};
+
+	// Every element is padded to a cache line of its own, so that processes pushing or popping
+	// neighbouring positions don't invalidate each other's line. Small elements take upto
+	// `CACHELINESIZE / sizeof(T)` times the memory.
+	struct PaddedLayout
+	{
+		template <typename T> struct alignas(detail::CACHELINESIZE) Slot
+		{
+			T value;
+		};
+
+		template <typename T> static constexpr auto Value(Slot<T>& slot) noexcept -> T&
+		{
+			return slot.value;
+		}
+		template <typename T>
+		static constexpr auto Value(const Slot<T>& slot) noexcept -> const T&
+		{
+			return slot.value;
+		}
+	};
+}
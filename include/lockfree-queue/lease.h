@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace lockfree
+{
+	// Pid leased from `Queue`, until the lease is destroyed. Queue must outlive the lease.
+	template <typename Queue> class PidLease
+	{
+	public:
+		// Returns nullopt, if all the queue's pids are leased.
+		static auto Acquire(Queue& queue) noexcept -> std::optional<PidLease>
+		{
+			if (auto pid = queue.AcquirePid())
+				return PidLease(queue, *pid);
+
+			return {};
+		}
+
+		PidLease(PidLease&& other) noexcept
+			: m_queue(std::exchange(other.m_queue, nullptr)), m_pid(other.m_pid)
+		{
+		}
+		auto operator=(PidLease&& other) noexcept -> PidLease&
+		{
+			if (this != &other)
+			{
+				release();
+				m_queue = std::exchange(other.m_queue, nullptr);
+				m_pid = other.m_pid;
+			}
+			return *this;
+		}
+
+		PidLease(const PidLease&) = delete;
+		auto operator=(const PidLease&) -> PidLease& = delete;
+
+		~PidLease() { release(); }
+
+		[[nodiscard]] auto Pid() const noexcept -> int { return m_pid; }
+
+	private:
+		PidLease(Queue& queue, int pid) noexcept : m_queue(&queue), m_pid(pid) {}
+
+		void release() noexcept
+		{
+			if (m_queue != nullptr)
+				m_queue->ReleasePid(m_pid);
+		}
+
+		Queue* m_queue = nullptr;
+		int m_pid = 0;
+	};
+
+	namespace detail
+	{
+		// Pids leased by the calling thread, one per queue, and released when the thread exits.
+		// Queues are held weakly, so that the ones destroyed before the thread aren't touched.
+		template <typename Queue> class ThreadPids
+		{
+		public:
+			static auto Get(const std::shared_ptr<Queue>& queue) -> std::optional<int>
+			{
+				auto& leases = instance().m_leases;
+
+				for (const auto& lease : leases)
+				{
+					if (lease.queue_ptr == queue.get() && !lease.queue.expired())
+						return lease.pid;
+				}
+
+				// Forget the queues destroyed meanwhile.
+				leases.erase(std::remove_if(leases.begin(), leases.end(),
+								 [](const Lease& lease) { return lease.queue.expired(); }),
+					leases.end());
+
+				auto pid = queue->AcquirePid();
+				if (pid)
+					leases.push_back({ queue, queue.get(), *pid });
+
+				return pid;
+			}
+
+			ThreadPids(const ThreadPids&) = delete;
+			ThreadPids(ThreadPids&&) = delete;
+			auto operator=(const ThreadPids&) -> ThreadPids& = delete;
+			auto operator=(ThreadPids&&) -> ThreadPids& = delete;
+
+			~ThreadPids()
+			{
+				for (const auto& lease : m_leases)
+				{
+					if (auto queue = lease.queue.lock())
+						queue->ReleasePid(lease.pid);
+				}
+			}
+
+		private:
+			struct Lease
+			{
+				std::weak_ptr<Queue> queue;
+				const Queue* queue_ptr;
+				int pid;
+			};
+
+			ThreadPids() = default;
+
+			static auto instance() -> ThreadPids&
+			{
+				thread_local ThreadPids pids;
+				return pids;
+			}
+
+			std::vector<Lease> m_leases;
+		};
+	}
+}
@@ -1,23 +1,39 @@
 #pragma once
 
+#include <algorithm>
 #include <boost/align/align_up.hpp>
 #include <boost/align/aligned_alloc.hpp>
+#include <cassert>
 #include <cstddef>
 #include <limits>
 #include <memory>
 #include <optional>
+#include <string_view>
 
 #include "lockfree-queue/backoff.h"
+#include "lockfree-queue/capacity.h"
+#include "lockfree-queue/detail/activeset.h"
+#include "lockfree-queue/detail/combining.h"
+#include "lockfree-queue/detail/credits.h"
 #include "lockfree-queue/detail/defs.h"
+#include "lockfree-queue/detail/pidset.h"
+#include "lockfree-queue/detail/ringbuf.h"
 #include "lockfree-queue/detail/scopeexit.h"
+#include "lockfree-queue/framing.h"
+#include "lockfree-queue/layout.h"
+#include "lockfree-queue/lease.h"
 
 
 namespace lockfree
 {
-	template <typename T> class alignas(std::max(detail::CACHELINESIZE, alignof(T))) MPMCQueue
+	// `Layout` is one of the policies in "lockfree-queue/layout.h".
+	template <typename T, typename Capacity = DynamicCapacity, typename Layout = DenseLayout>
+	class alignas(std::max(detail::CACHELINESIZE, alignof(T))) MPMCQueue
 	{
 		static_assert(std::is_trivial_v<T>, "Type must be trivial to be store inside queue");
 
+		using slot_type = typename Layout::template Slot<T>;
+
 	public:
 		using size_type = std::size_t;
 		using value_type = T;
@@ -30,9 +46,15 @@ namespace lockfree
 
 			size = boost::alignment::align_up(size, alignof(ThreadPos));
 			size += sizeof(ThreadPos) * max_processes;
+			size = boost::alignment::align_up(size, alignof(detail::ActiveWord));
+			size += 2 * detail::active_set_size(max_processes);
+			size = boost::alignment::align_up(size, alignof(detail::PidWord));
+			size += detail::pid_set_size(max_processes);
+			size = boost::alignment::align_up(size, alignof(detail::CombineSlot<T>));
+			size += sizeof(detail::CombineSlot<T>) * max_processes;
 
 			return boost::alignment::align_up(size, alignof(MPMCQueue)) +
-				   queue_size * sizeof(value_type);
+				   queue_size * sizeof(slot_type);
 		}
 
 		static auto Initialize(void* queue_ptr, int max_processes, size_type queue_size) noexcept
@@ -44,23 +66,47 @@ namespace lockfree
 
 		auto TryPush(int pid, const value_type& val) noexcept -> bool
 		{
-			SCOPE_EXIT([&] { detail::store_release(get_tpos_data()[pid].head, INVALID_Q_POS); });
+			return TryPushN(pid, &val, 1) == 1;
+		}
+
+		// Reserves the slots for upto `count` elements at once. Returns the number pushed.
+		auto TryPushN(int pid, const value_type* vals, size_type count) noexcept -> size_type
+		{
+			detail::set_active(get_active_producers(), m_max_processes, pid);
+			SCOPE_EXIT([&] {
+				detail::store_release(get_tpos_data()[pid].head, INVALID_Q_POS);
+				detail::clear_active(get_active_producers(), m_max_processes, pid);
+			});
 
-			if (auto head = reserve_head_to_produce(pid))
+			if (auto head = reserve_head_to_produce(pid, count))
 			{
-				get_queue_data()[*head % m_queue_size] = val;
-				return true;
+				detail::copy_into_ring<Layout>(get_queue_data(), m_capacity, *head, vals, count);
+				return count;
 			}
 
-			return false;
+			return 0;
 		}
 
-		auto TryPop(int pid) noexcept -> std::optional<value_type>
+		// Flat combining variant of `TryPush`, for heavily contended queues. Element is published
+		// in the producer's slot, and whichever producer takes the combiner role pushes all the
+		// published elements at once, with a single head update.
+		auto TryPushCombined(int pid, const value_type& val) noexcept -> bool
 		{
-			SCOPE_EXIT([&] { detail::store_release(get_tpos_data()[pid].tail, INVALID_Q_POS); });
+			auto* slots = get_combine_slots();
+
+			return detail::combine_push(
+				m_combining, m_max_processes, pid, val,
+				[slots](int i) -> detail::CombineSlot<T>& { return slots[i]; },
+				[&](const value_type* vals, size_type count) {
+					return TryPushN(pid, vals, count);
+				});
+		}
 
-			if (auto tail = reserve_tail_to_consume(pid))
-				return get_queue_data()[*tail % m_queue_size];
+		auto TryPop(int pid) noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPop(pid, val))
+				return val;
 
 			return {};
 		}
@@ -68,15 +114,34 @@ namespace lockfree
 		// Use this variant to avoid need to double copy.
 		auto TryPop(int pid, value_type& outval) noexcept -> bool
 		{
-			SCOPE_EXIT([&] { detail::store_release(get_tpos_data()[pid].tail, INVALID_Q_POS); });
+			return TryPopN(pid, &outval, 1) == 1;
+		}
+
+		// Reserves upto `count` elements at once. Returns the number popped.
+		auto TryPopN(int pid, value_type* out, size_type count) noexcept -> size_type
+		{
+			detail::set_active(get_active_consumers(), m_max_processes, pid);
+			SCOPE_EXIT([&] {
+				detail::store_release(get_tpos_data()[pid].tail, INVALID_Q_POS);
+				detail::clear_active(get_active_consumers(), m_max_processes, pid);
+			});
 
-			if (auto tail = reserve_tail_to_consume(pid))
+			if (auto tail = reserve_tail_to_consume(pid, count))
 			{
-				outval = get_queue_data()[*tail % m_queue_size];
-				return true;
+				detail::copy_out_of_ring<Layout>(get_queue_data(), m_capacity, *tail, out, count);
+				return count;
 			}
-			return false;
+
+			return 0;
+		}
+
+		// Leases a free pid, for the callers which can't assign pids themselves. Returns nullopt,
+		// if all the pids are leased. Must not be mixed with pids assigned by the caller.
+		auto AcquirePid() noexcept -> std::optional<int>
+		{
+			return detail::acquire_pid(get_pid_set(), m_max_processes);
 		}
+		void ReleasePid(int pid) noexcept { detail::release_pid(get_pid_set(), pid); }
 
 		auto IsEmpty() noexcept -> bool
 		{
@@ -120,11 +185,19 @@ namespace lockfree
 		};
 
 		MPMCQueue(int max_processes, size_type queue_size) noexcept
-			: m_max_processes(max_processes), m_queue_size(queue_size)
+			: m_max_processes(max_processes), m_capacity(queue_size)
 		{
 			auto* tpos = get_tpos_data();
+			auto* slots = get_combine_slots();
 			for (int i = 0; i < max_processes; i++)
+			{
 				new (&tpos[i]) ThreadPos{};
+				new (&slots[i]) detail::CombineSlot<T>{};
+			}
+
+			detail::init_active_set(get_active_producers(), max_processes);
+			detail::init_active_set(get_active_consumers(), max_processes);
+			detail::init_pid_set(get_pid_set(), max_processes);
 		}
 
 
@@ -133,11 +206,9 @@ namespace lockfree
 			auto last_tail = detail::load_acquire(m_tail);
 			const auto* tpos = get_tpos_data();
 
-			for (int i = 0; i < m_max_processes; i++)
-			{
-				auto tail = detail::load_acquire(tpos[i].tail);
-				last_tail = std::min(tail, last_tail);
-			}
+			detail::for_each_active(get_active_consumers(), m_max_processes, [&](int pid) {
+				last_tail = std::min(last_tail, detail::load_acquire(tpos[pid].tail));
+			});
 
 			if (last_tail > old_last_tail &&
 				!m_last_tail.compare_exchange_strong(old_last_tail, last_tail) &&
@@ -152,11 +223,9 @@ namespace lockfree
 			auto last_head = detail::load_acquire(m_head);
 			const auto* tpos = get_tpos_data();
 
-			for (int i = 0; i < m_max_processes; i++)
-			{
-				auto head = detail::load_acquire(tpos[i].head);
-				last_head = std::min(last_head, head);
-			}
+			detail::for_each_active(get_active_producers(), m_max_processes, [&](int pid) {
+				last_head = std::min(last_head, detail::load_acquire(tpos[pid].head));
+			});
 
 			if (last_head > old_last_head &&
 				!m_last_head.compare_exchange_strong(old_last_head, last_head) &&
@@ -167,20 +236,27 @@ namespace lockfree
 		}
 
 
+		// Reserves upto `count` slots, starting at the returned position, in one step. `count` is
+		// set to the number reserved.
 		template <bool TryAgain = true>
-		auto reserve_head_to_produce(int pid) noexcept -> std::optional<size_type>
+		auto reserve_head_to_produce(int pid, size_type& count) noexcept -> std::optional<size_type>
 		{
 			auto head = detail::load_acquire(m_head);
 			auto last_tail = detail::load_acquire(m_last_tail);
 			auto* tpos = get_tpos_data();
 			ExponentialBackoff backoff;
 
-			while (!is_full(head, last_tail))
+			while (count != 0 && !is_full(head, last_tail))
 			{
+				const auto reserved = std::min(count, last_tail + m_capacity.Size() - head);
+
 				detail::store_release(tpos[pid].head, head);
 
-				if (m_head.compare_exchange_strong(head, head + 1))
+				if (m_head.compare_exchange_strong(head, head + reserved))
+				{
+					count = reserved;
 					return head;
+				}
 
 				backoff();
 
@@ -191,26 +267,32 @@ namespace lockfree
 			if constexpr (TryAgain)
 			{
 				update_last_tail(last_tail);
-				return reserve_head_to_produce<false>(pid);
+				return reserve_head_to_produce<false>(pid, count);
 			}
 
 			return {};
 		}
 
+		// Counterpart of `reserve_head_to_produce`.
 		template <bool TryAgain = true>
-		auto reserve_tail_to_consume(int pid) -> std::optional<size_type>
+		auto reserve_tail_to_consume(int pid, size_type& count) -> std::optional<size_type>
 		{
 			auto last_head = detail::load_acquire(m_last_head);
 			auto tail = detail::load_acquire(m_tail);
 			auto* tpos = get_tpos_data();
 			ExponentialBackoff backoff;
 
-			while (!is_empty(last_head, tail))
+			while (count != 0 && !is_empty(last_head, tail))
 			{
+				const auto reserved = std::min(count, last_head - tail);
+
 				detail::store_release(tpos[pid].tail, tail);
 
-				if (m_tail.compare_exchange_strong(tail, tail + 1))
+				if (m_tail.compare_exchange_strong(tail, tail + reserved))
+				{
+					count = reserved;
 					return tail;
+				}
 
 				backoff();
 
@@ -221,7 +303,7 @@ namespace lockfree
 			if constexpr (TryAgain)
 			{
 				update_last_head(last_head);
-				return reserve_tail_to_consume<false>(pid);
+				return reserve_tail_to_consume<false>(pid, count);
 			}
 
 			return {};
@@ -230,7 +312,7 @@ namespace lockfree
 
 		[[nodiscard]] auto is_full(size_type head, size_type tail) const noexcept -> bool
 		{
-			return head >= tail + m_queue_size;
+			return head >= tail + m_capacity.Size();
 		}
 		static auto is_empty(size_type head, size_type tail) noexcept -> bool
 		{
@@ -250,13 +332,39 @@ namespace lockfree
 			return const_cast<MPMCQueue*>(this)->get_tpos_data();
 		}
 
-		auto get_queue_data() noexcept -> T*
+		// Producers' set is followed by the consumers' set.
+		auto get_active_producers() noexcept -> detail::ActiveWord*
 		{
 			auto* p = reinterpret_cast<char*>(get_tpos_data());
-			return static_cast<T*>(boost::alignment::align_up(
-				p + sizeof(ThreadPos) * m_max_processes, detail::CACHELINESIZE));
+			return static_cast<detail::ActiveWord*>(boost::alignment::align_up(
+				p + sizeof(ThreadPos) * m_max_processes, alignof(detail::ActiveWord)));
 		}
-		[[nodiscard]] auto get_queue_data() const noexcept -> const T*
+		auto get_active_consumers() noexcept -> detail::ActiveWord*
+		{
+			return get_active_producers() + detail::active_set_words(m_max_processes);
+		}
+
+		auto get_pid_set() noexcept -> detail::PidWord*
+		{
+			auto* p = reinterpret_cast<char*>(get_active_producers());
+			return static_cast<detail::PidWord*>(boost::alignment::align_up(
+				p + 2 * detail::active_set_size(m_max_processes), alignof(detail::PidWord)));
+		}
+
+		auto get_combine_slots() noexcept -> detail::CombineSlot<T>*
+		{
+			auto* p = reinterpret_cast<char*>(get_pid_set());
+			return static_cast<detail::CombineSlot<T>*>(boost::alignment::align_up(
+				p + detail::pid_set_size(m_max_processes), alignof(detail::CombineSlot<T>)));
+		}
+
+		auto get_queue_data() noexcept -> slot_type*
+		{
+			auto* p = reinterpret_cast<char*>(get_combine_slots());
+			return static_cast<slot_type*>(boost::alignment::align_up(
+				p + sizeof(detail::CombineSlot<T>) * m_max_processes, detail::CACHELINESIZE));
+		}
+		[[nodiscard]] auto get_queue_data() const noexcept -> const slot_type*
 		{
 			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
 			return const_cast<MPMCQueue*>(this)->get_queue_data();
@@ -264,42 +372,864 @@ namespace lockfree
 
 
 		const int m_max_processes;
-		const size_type m_queue_size;
+		const Capacity m_capacity;
 
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_last_head = 0;
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_last_tail = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<bool> m_combining = false;
 	};
 
-	namespace thread
+	// Same interface as `MPMCQueue`, but positions are handed out as tickets. A push or pop takes a
+	// credit and its ticket with one `fetch_add` each, and then waits for its turn on the slot,
+	// instead of retrying a CAS and scanning the processes' positions. A slot's turn only waits for
+	// the operation of the previous ticket on it, which already holds its own ticket.
+	// `max_processes` is accepted only for compatibility and `pid` is ignored.
+	template <typename T, typename Capacity = DynamicCapacity> class MPMCSeqQueue
 	{
-		template <typename T> class MPMCQueue
+		static_assert(std::is_trivial_v<T>, "Type must be trivial to be store inside queue");
+
+	public:
+		using size_type = std::size_t;
+		using value_type = T;
+
+		static constexpr auto GetAlignment() noexcept -> size_type
 		{
-		public:
-			using size_type = std::size_t;
-			using value_type = T;
+			return std::max(alignof(MPMCSeqQueue), alignof(Slot));
+		}
 
-			MPMCQueue(int max_processes, size_type queue_size)
-				: m_queue(
-					  detail::MakeAndInitialize<lockfree::MPMCQueue<T>>(max_processes, queue_size))
+		static constexpr auto CalculateSize(int /*max_processes*/, size_type queue_size) noexcept
+			-> size_type
+		{
+			return boost::alignment::align_up(sizeof(MPMCSeqQueue), alignof(Slot)) +
+				   queue_size * sizeof(Slot);
+		}
+
+		static auto Initialize(void* queue_ptr, int /*max_processes*/,
+			size_type queue_size) noexcept -> MPMCSeqQueue*
+		{
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			return new (static_cast<MPMCSeqQueue*>(queue_ptr)) MPMCSeqQueue(queue_size);
+		}
+
+		auto TryPush(int /*pid*/, const value_type& val) noexcept -> bool
+		{
+			if (!take_credit(m_free))
+				return false;
+
+			const auto head = m_head.fetch_add(1);
+			auto& slot = get_slots()[m_capacity.Wrap(head)];
+
+			// Slot's previous element may have been claimed, but not yet read.
+			wait_turn(slot, head);
+			slot.value = val;
+			detail::store_release(slot.seq, head + 1);
+			m_used.fetch_add(1);
+
+			return true;
+		}
+
+		auto TryPop(int pid) noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPop(pid, val))
+				return val;
+
+			return {};
+		}
+
+		// Use this variant to avoid need to double copy.
+		auto TryPop(int /*pid*/, value_type& outval) noexcept -> bool
+		{
+			if (!take_credit(m_used))
+				return false;
+
+			const auto tail = m_tail.fetch_add(1);
+			auto& slot = get_slots()[m_capacity.Wrap(tail)];
+
+			// Credit may be of a later element, so this one may still be being written.
+			wait_turn(slot, tail + 1);
+			outval = slot.value;
+			detail::store_release(slot.seq, tail + m_capacity.Size());
+			m_free.fetch_add(1);
+
+			return true;
+		}
+
+		auto IsEmpty() noexcept -> bool { return detail::load_acquire(m_used) <= 0; }
+
+		auto IsFull() noexcept -> bool { return detail::load_acquire(m_free) <= 0; }
+
+	private:
+		// `seq` is `pos` when the slot is free for the element at `pos`, and `pos + 1` once the
+		// element is written. Each slot is on its own cache line, so that the operations on
+		// neighbouring tickets don't contend.
+		struct alignas(detail::CACHELINESIZE) Slot
+		{
+			std::atomic<size_type> seq;
+			value_type value;
+		};
+
+		explicit MPMCSeqQueue(size_type queue_size) noexcept
+			: m_capacity(queue_size), m_free(static_cast<std::ptrdiff_t>(queue_size))
+		{
+			auto* slots = get_slots();
+			for (size_type i = 0; i < queue_size; i++)
+				new (&slots[i]) Slot{ i, {} };
+		}
+
+		static auto take_credit(std::atomic<std::ptrdiff_t>& credits) noexcept -> bool
+		{
+			if (detail::load_relaxed(credits) <= 0)
+				return false;
+
+			if (credits.fetch_sub(1) <= 0)
 			{
+				credits.fetch_add(1);
+				return false;
 			}
 
-			auto TryPush(int pid, const value_type& val) noexcept -> bool
+			return true;
+		}
+
+		static void wait_turn(const Slot& slot, size_type seq) noexcept
+		{
+			ExponentialBackoff backoff;
+
+			while (detail::load_acquire(slot.seq) != seq)
+				backoff();
+		}
+
+		auto get_slots() noexcept -> Slot*
+		{
+			auto* p = reinterpret_cast<char*>(this);
+			return reinterpret_cast<Slot*>(
+				boost::alignment::align_up(p + sizeof(MPMCSeqQueue), alignof(Slot)));
+		}
+
+
+		const Capacity m_capacity;
+
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<std::ptrdiff_t> m_free; // Credits to push
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<std::ptrdiff_t> m_used = 0; // Credits to pop
+	};
+
+	// Same interface as `MPMCQueue`, but wait-free: every push and pop returns in a bounded number
+	// of steps, whatever the other processes do. A scan of the positions is `O(max_processes)`,
+	// and advancing the bound retries at most `queue_size` times (see `update_bound`).
+	// Positions are handed out with `fetch_add`, instead of a CAS retried with a backoff, and are
+	// backed by credits taken beforehand. Credits are granted only for the slots below the
+	// `ThreadPos` bound of `MPMCQueue`, so no operation ever waits for another one to finish its
+	// copy. An operation, which runs short of credits, scans the processes' positions and advances
+	// the bound for everyone. A process, which keeps losing the race for the credits, is helped
+	// through its `ThreadPos` by the others (see "lockfree-queue/detail/credits.h").
+	// So a push or pop fails only when the queue is full or empty, or, like `MPMCQueue`, when a
+	// slow process is still copying the elements next to the bound.
+	template <typename T, typename Capacity = DynamicCapacity>
+	class alignas(std::max(detail::CACHELINESIZE, alignof(T))) MPMCWaitFreeQueue
+	{
+		static_assert(std::is_trivial_v<T>, "Type must be trivial to be store inside queue");
+
+	public:
+		using size_type = std::size_t;
+		using value_type = T;
+
+		static auto CalculateSize(int max_processes, size_type queue_size) noexcept -> size_type
+		{
+			auto size = sizeof(MPMCWaitFreeQueue);
+
+			static_assert(std::is_trivially_copyable_v<MPMCWaitFreeQueue>);
+
+			size = boost::alignment::align_up(size, alignof(ThreadPos));
+			size += sizeof(ThreadPos) * max_processes;
+			size = boost::alignment::align_up(size, alignof(detail::ActiveWord));
+			size += 2 * detail::active_set_size(max_processes);
+
+			return boost::alignment::align_up(size, alignof(MPMCWaitFreeQueue)) +
+				   queue_size * sizeof(T);
+		}
+
+		static auto Initialize(void* queue_ptr, int max_processes, size_type queue_size) noexcept
+			-> MPMCWaitFreeQueue*
+		{
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			return new (static_cast<MPMCWaitFreeQueue*>(queue_ptr))
+				MPMCWaitFreeQueue(max_processes, queue_size);
+		}
+
+		auto TryPush(int pid, const value_type& val) noexcept -> bool
+		{
+			return TryPushN(pid, &val, 1) == 1;
+		}
+
+		// Pushes upto `count` elements at once. Returns the number pushed.
+		auto TryPushN(int pid, const value_type* vals, size_type count) noexcept -> size_type
+		{
+			auto& pos = get_tpos_data()[pid].head;
+
+			// Lower bound of the position we get, published before we get it.
+			detail::set_active(get_active_producers(), m_max_processes, pid);
+			detail::store_release(pos, detail::load_acquire(m_head));
+			SCOPE_EXIT([&] {
+				detail::store_release(pos, INVALID_Q_POS);
+				detail::clear_active(get_active_producers(), m_max_processes, pid);
+			});
+
+			count = take_credits(push_credits(), pid, count, [this] { update_last_tail(); });
+			if (count != 0)
 			{
-				return m_queue->TryPush(pid, val);
+				const auto head = m_head.fetch_add(count);
+				detail::copy_into_ring<DenseLayout>(
+					get_queue_data(), m_capacity, head, vals, count);
 			}
 
-			auto TryPop(int pid) noexcept -> std::optional<value_type>
+			return count;
+		}
+
+		auto TryPop(int pid) noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPop(pid, val))
+				return val;
+
+			return {};
+		}
+
+		// Use this variant to avoid need to double copy.
+		auto TryPop(int pid, value_type& outval) noexcept -> bool
+		{
+			return TryPopN(pid, &outval, 1) == 1;
+		}
+
+		// Pops upto `count` elements at once. Returns the number popped.
+		auto TryPopN(int pid, value_type* out, size_type count) noexcept -> size_type
+		{
+			auto& pos = get_tpos_data()[pid].tail;
+
+			detail::set_active(get_active_consumers(), m_max_processes, pid);
+			detail::store_release(pos, detail::load_acquire(m_tail));
+			SCOPE_EXIT([&] {
+				detail::store_release(pos, INVALID_Q_POS);
+				detail::clear_active(get_active_consumers(), m_max_processes, pid);
+			});
+
+			count = take_credits(pop_credits(), pid, count, [this] { update_last_head(); });
+			if (count != 0)
 			{
-				return m_queue->TryPop(pid);
+				const auto tail = m_tail.fetch_add(count);
+				detail::copy_out_of_ring<DenseLayout>(
+					get_queue_data(), m_capacity, tail, out, count);
 			}
 
-			// Use this variant to avoid need to double copy.
-			auto TryPop(int pid, value_type& outval) noexcept -> bool
+			return count;
+		}
+
+		auto IsEmpty() noexcept -> bool
+		{
+			if (pop_credits().Available() != 0)
+				return false;
+
+			update_last_head();
+			return pop_credits().Available() == 0;
+		}
+
+		auto IsFull() noexcept -> bool
+		{
+			if (push_credits().Available() != 0)
+				return false;
+
+			update_last_tail();
+			return push_credits().Available() == 0;
+		}
+
+	private:
+		static constexpr auto INVALID_Q_POS = std::numeric_limits<size_type>::max();
+
+		// Lower bound of the position being pushed or popped by a process, or `INVALID_Q_POS`,
+		// and its requests for help in taking the credits.
+		struct alignas(detail::CACHELINESIZE) ThreadPos
+		{
+			std::atomic<size_type> head = INVALID_Q_POS;
+			std::atomic<size_type> tail = INVALID_Q_POS;
+			detail::CreditRequest push_request;
+			detail::CreditRequest pop_request;
+		};
+
+		MPMCWaitFreeQueue(int max_processes, size_type queue_size) noexcept
+			: m_max_processes(max_processes), m_capacity(queue_size)
+		{
+			assert(max_processes < (1 << (64 - detail::CREDIT_TAKEN_BITS)) - 1);
+			assert(queue_size <= detail::CREDIT_TAKEN_MASK / 2);
+
+			auto* tpos = get_tpos_data();
+			for (int i = 0; i < max_processes; i++)
+				new (&tpos[i]) ThreadPos{};
+
+			detail::init_active_set(get_active_producers(), max_processes);
+			detail::init_active_set(get_active_consumers(), max_processes);
+		}
+
+
+		// Credits to push are granted upto a lap ahead of the slots read.
+		auto push_credits() noexcept
+		{
+			auto* tpos = get_tpos_data();
+
+			return detail::CreditPool(
+				m_push_taken, m_max_processes,
+				[tpos](int pid) -> detail::CreditRequest& { return tpos[pid].push_request; },
+				[this] { return detail::load_acquire(m_last_tail) + m_capacity.Size(); });
+		}
+
+		// Credits to pop are granted upto the slots written.
+		auto pop_credits() noexcept
+		{
+			auto* tpos = get_tpos_data();
+
+			return detail::CreditPool(
+				m_pop_taken, m_max_processes,
+				[tpos](int pid) -> detail::CreditRequest& { return tpos[pid].pop_request; },
+				[this] { return detail::load_acquire(m_last_head); });
+		}
+
+		// Takes upto `count` credits. If there aren't enough, `refill()` is called once to grant
+		// more. Returns the number taken.
+		template <typename Pool, typename Refill>
+		static auto take_credits(Pool&& pool, int pid, size_type count, Refill&& refill) noexcept
+			-> size_type
+		{
+			auto taken = pool.Take(pid, count);
+
+			if (taken != count)
 			{
-				return m_queue->TryPop(pid, outval);
+				refill();
+				taken += pool.Take(pid, count - taken);
+			}
+
+			return taken;
+		}
+
+		// Moves the bound upto the lowest position of the active processes.
+		// A CAS fails only if another process moved the bound up, but short of `new_bound`. The
+		// positions are at most a lap ahead of the bound, once it is loaded after the scan, so the
+		// CAS fails at most `m_capacity.Size()` times.
+		template <typename Pos>
+		void update_bound(std::atomic<size_type>& bound, const std::atomic<size_type>& next_pos,
+			const detail::ActiveWord* active, Pos&& pos) noexcept
+		{
+			auto new_bound = detail::load_acquire(next_pos);
+			const auto* tpos = get_tpos_data();
+
+			detail::for_each_active(active, m_max_processes, [&](int pid) {
+				new_bound = std::min(new_bound, detail::load_acquire(pos(tpos[pid])));
+			});
+
+			auto old_bound = detail::load_acquire(bound);
+			while (new_bound > old_bound && !bound.compare_exchange_strong(old_bound, new_bound))
+				;
+		}
+
+		// Slots below `m_last_tail` are read, so they can be pushed into once more.
+		void update_last_tail() noexcept
+		{
+			update_bound(m_last_tail, m_tail, get_active_consumers(),
+				[](const ThreadPos& tpos) -> const auto& { return tpos.tail; });
+		}
+
+		// Slots below `m_last_head` are written, so they can be popped.
+		void update_last_head() noexcept
+		{
+			update_bound(m_last_head, m_head, get_active_producers(),
+				[](const ThreadPos& tpos) -> const auto& { return tpos.head; });
+		}
+
+
+		auto get_tpos_data() noexcept -> ThreadPos*
+		{
+			auto* p = reinterpret_cast<char*>(this);
+			return static_cast<ThreadPos*>(
+				boost::alignment::align_up(p + sizeof(MPMCWaitFreeQueue), alignof(ThreadPos)));
+		}
+
+		// Producers' set is followed by the consumers' set.
+		auto get_active_producers() noexcept -> detail::ActiveWord*
+		{
+			auto* p = reinterpret_cast<char*>(get_tpos_data());
+			return static_cast<detail::ActiveWord*>(boost::alignment::align_up(
+				p + sizeof(ThreadPos) * m_max_processes, alignof(detail::ActiveWord)));
+		}
+		auto get_active_consumers() noexcept -> detail::ActiveWord*
+		{
+			return get_active_producers() + detail::active_set_words(m_max_processes);
+		}
+
+		auto get_queue_data() noexcept -> T*
+		{
+			auto* p = reinterpret_cast<char*>(get_active_producers());
+			return static_cast<T*>(boost::alignment::align_up(
+				p + 2 * detail::active_set_size(m_max_processes), detail::CACHELINESIZE));
+		}
+
+
+		const int m_max_processes;
+		const Capacity m_capacity;
+
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<std::uint64_t> m_push_taken = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<std::uint64_t> m_pop_taken = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_last_head = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_last_tail = 0;
+	};
+
+	// Variable size elements, framed as in `MPSCQueueAny`, with any number of consumers. Producers
+	// and consumers reserve byte ranges with the `ThreadPos` scheme of `MPMCQueue`, so payloads are
+	// copied straight in and out of the shared ring buffer.
+	class alignas(detail::CACHELINESIZE) MPMCQueueAny
+	{
+	public:
+		using size_type = std::size_t;
+
+		static auto CalculateSize(int max_processes, size_type queue_size,
+			const Framing& /*framing*/ = {}) noexcept -> size_type
+		{
+			auto size = sizeof(MPMCQueueAny);
+
+			size = boost::alignment::align_up(size, alignof(ThreadPos));
+			size += sizeof(ThreadPos) * max_processes;
+			size = boost::alignment::align_up(size, alignof(detail::ActiveWord));
+			size += 2 * detail::active_set_size(max_processes);
+
+			return boost::alignment::align_up(size, alignof(MPMCQueueAny)) + queue_size;
+		}
+
+		// `queue_size` must be a multiple of `framing.PayloadAlignment()`.
+		static auto Initialize(void* queue_ptr, int max_processes, size_type queue_size,
+			const Framing& framing = {}) noexcept -> MPMCQueueAny*
+		{
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			return new (static_cast<MPMCQueueAny*>(queue_ptr))
+				MPMCQueueAny(max_processes, queue_size, framing);
+		}
+
+		auto TryPush(int pid, const void* elem, size_type elemsize) noexcept -> bool
+		{
+			detail::set_active(get_active_producers(), m_max_processes, pid);
+			SCOPE_EXIT([&] {
+				detail::store_release(get_tpos_data()[pid].head, INVALID_Q_POS);
+				detail::clear_active(get_active_producers(), m_max_processes, pid);
+			});
+
+			if (auto head = reserve_head_to_produce(pid, elemsize))
+			{
+				detail::copy_elem_into_ringbuf(
+					get_queue_data(), m_capacity, false, m_framing, *head, elem, elemsize);
+				return true;
+			}
+
+			return false;
+		}
+
+		// Pops the front element into `elem`, which holds `bufsize` bytes. Element is truncated,
+		// if it's larger. Returns the element's size.
+		auto TryPop(int pid, void* elem, size_type bufsize) noexcept -> std::optional<size_type>
+		{
+			detail::set_active(get_active_consumers(), m_max_processes, pid);
+			SCOPE_EXIT([&] {
+				detail::store_release(get_tpos_data()[pid].tail, INVALID_Q_POS);
+				detail::clear_active(get_active_consumers(), m_max_processes, pid);
+			});
+
+			size_type elemsize;
+			if (auto tail = reserve_tail_to_consume(pid, elemsize))
+			{
+				detail::copy_out_of_ringbuf(get_queue_data(), m_capacity, false,
+					m_framing.PayloadPos(*tail), elem, std::min(bufsize, elemsize));
+				return elemsize;
+			}
+
+			return {};
+		}
+
+		auto IsEmpty() noexcept -> bool
+		{
+			const auto last_head = detail::load_acquire(m_last_head);
+			if (is_empty(last_head, detail::load_acquire(m_tail)))
+			{
+				update_last_head(last_head);
+				return is_empty(detail::load_acquire(m_last_head), detail::load_acquire(m_tail));
+			}
+
+			return false;
+		}
+
+		auto IsFull() noexcept -> bool
+		{
+			const auto last_tail = detail::load_acquire(m_last_tail);
+			if (is_full(detail::load_acquire(m_head), last_tail, 1))
+			{
+				update_last_tail(last_tail);
+				return is_full(detail::load_acquire(m_head), detail::load_acquire(m_last_tail), 1);
+			}
+
+			return false;
+		}
+
+	private:
+		static constexpr auto INVALID_Q_POS = std::numeric_limits<size_type>::max();
+
+		struct alignas(detail::CACHELINESIZE) ThreadPos
+		{
+			std::atomic<size_type> head = INVALID_Q_POS;
+			std::atomic<size_type> tail = INVALID_Q_POS;
+		};
+
+		MPMCQueueAny(int max_processes, size_type queue_size, const Framing& framing) noexcept
+			: m_max_processes(max_processes), m_capacity(queue_size), m_framing(framing)
+		{
+			assert(queue_size % framing.PayloadAlignment() == 0);
+
+			auto* tpos = get_tpos_data();
+			for (int i = 0; i < max_processes; i++)
+				new (&tpos[i]) ThreadPos{};
+
+			detail::init_active_set(get_active_producers(), max_processes);
+			detail::init_active_set(get_active_consumers(), max_processes);
+		}
+
+
+		// Unlike `MPMCQueue`, consumers read the element's header before reserving it. So the
+		// consumers' positions are read sequentially consistent, after `m_tail`, for a consumer
+		// which found `m_tail` unchanged after publishing its position to be always accounted.
+		void update_last_tail(size_type old_last_tail) noexcept
+		{
+			auto last_tail = m_tail.load();
+			const auto* tpos = get_tpos_data();
+
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			detail::for_each_active(get_active_consumers(), m_max_processes, [&](int pid) {
+				last_tail = std::min(last_tail, tpos[pid].tail.load());
+			});
+
+			if (last_tail > old_last_tail &&
+				!m_last_tail.compare_exchange_strong(old_last_tail, last_tail) &&
+				old_last_tail < last_tail)
+			{
+				update_last_tail(old_last_tail);
+			}
+		}
+
+		void update_last_head(size_type old_last_head) noexcept
+		{
+			auto last_head = detail::load_acquire(m_head);
+			const auto* tpos = get_tpos_data();
+
+			detail::for_each_active(get_active_producers(), m_max_processes, [&](int pid) {
+				last_head = std::min(last_head, detail::load_acquire(tpos[pid].head));
+			});
+
+			if (last_head > old_last_head &&
+				!m_last_head.compare_exchange_strong(old_last_head, last_head) &&
+				old_last_head < last_head)
+			{
+				update_last_head(old_last_head);
+			}
+		}
+
+
+		// `elemsize` is the payload's size. Padding and header are added, as per `m_framing`.
+		template <bool TryAgain = true>
+		auto reserve_head_to_produce(int pid, size_type elemsize) noexcept
+			-> std::optional<size_type>
+		{
+			auto head = detail::load_acquire(m_head);
+			auto last_tail = detail::load_acquire(m_last_tail);
+			auto* tpos = get_tpos_data();
+			ExponentialBackoff backoff;
+
+			while (!is_full(head, last_tail, m_framing.ElemEnd(head, elemsize) - head))
+			{
+				detail::store_release(tpos[pid].head, head);
+
+				if (m_head.compare_exchange_strong(head, m_framing.ElemEnd(head, elemsize)))
+					return head;
+
+				backoff();
+
+				head = detail::load_acquire(m_head);
+				last_tail = detail::load_acquire(m_last_tail);
+			}
+
+			if constexpr (TryAgain)
+			{
+				update_last_tail(last_tail);
+				return reserve_head_to_produce<false>(pid, elemsize);
+			}
+
+			return {};
+		}
+
+		// Reserves the front element, whose payload's size is set to `elemsize`.
+		template <bool TryAgain = true>
+		auto reserve_tail_to_consume(int pid, size_type& elemsize) noexcept
+			-> std::optional<size_type>
+		{
+			auto last_head = detail::load_acquire(m_last_head);
+			auto tail = detail::load_acquire(m_tail);
+			auto* tpos = get_tpos_data();
+			ExponentialBackoff backoff;
+
+			while (!is_empty(last_head, tail))
+			{
+				// Once `tail` is published and still current, producers can't overwrite the
+				// element at `tail`, so its header can be read before reserving it.
+				tpos[pid].tail.store(tail);
+
+				if (m_tail.load() == tail)
+				{
+					elemsize = detail::read_elem_size(
+						get_queue_data(), m_capacity, false, m_framing, tail);
+
+					if (m_tail.compare_exchange_strong(tail, m_framing.ElemEnd(tail, elemsize)))
+						return tail;
+				}
+
+				backoff();
+
+				last_head = detail::load_acquire(m_last_head);
+				tail = detail::load_acquire(m_tail);
+			}
+
+			if constexpr (TryAgain)
+			{
+				update_last_head(last_head);
+				return reserve_tail_to_consume<false>(pid, elemsize);
+			}
+
+			return {};
+		}
+
+
+		[[nodiscard]] auto is_full(
+			size_type head, size_type tail, size_type elemsize) const noexcept -> bool
+		{
+			return head + elemsize - 1 >= tail + m_capacity.Size();
+		}
+		static auto is_empty(size_type head, size_type tail) noexcept -> bool
+		{
+			return tail >= head;
+		}
+
+
+		auto get_tpos_data() noexcept -> ThreadPos*
+		{
+			auto* p = reinterpret_cast<char*>(this);
+			return static_cast<ThreadPos*>(
+				boost::alignment::align_up(p + sizeof(MPMCQueueAny), alignof(ThreadPos)));
+		}
+
+		// Producers' set is followed by the consumers' set.
+		auto get_active_producers() noexcept -> detail::ActiveWord*
+		{
+			auto* p = reinterpret_cast<char*>(get_tpos_data());
+			return static_cast<detail::ActiveWord*>(boost::alignment::align_up(
+				p + sizeof(ThreadPos) * m_max_processes, alignof(detail::ActiveWord)));
+		}
+		auto get_active_consumers() noexcept -> detail::ActiveWord*
+		{
+			return get_active_producers() + detail::active_set_words(m_max_processes);
+		}
+
+		auto get_queue_data() noexcept -> char*
+		{
+			auto* p = reinterpret_cast<char*>(get_active_consumers());
+			return static_cast<char*>(boost::alignment::align_up(
+				p + detail::active_set_size(m_max_processes), detail::CACHELINESIZE));
+		}
+
+
+		const int m_max_processes;
+		const DynamicCapacity m_capacity;
+		const Framing m_framing;
+
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_last_head = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_last_tail = 0;
+	};
+
+	static_assert(std::is_trivially_copyable_v<MPMCQueueAny>);
+
+	namespace thread
+	{
+		template <typename T, typename Capacity = DynamicCapacity, typename Layout = DenseLayout>
+		class MPMCQueue
+		{
+		public:
+			using size_type = std::size_t;
+			using value_type = T;
+
+			MPMCQueue(int max_processes, size_type queue_size)
+				: m_queue(detail::MakeAndInitialize<lockfree::MPMCQueue<T, Capacity, Layout>>(
+					  max_processes, queue_size))
+			{
+			}
+
+			auto TryPush(int pid, const value_type& val) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, val);
+			}
+			auto TryPushCombined(int pid, const value_type& val) noexcept -> bool
+			{
+				return m_queue->TryPushCombined(pid, val);
+			}
+
+			auto TryPop(int pid) noexcept -> std::optional<value_type>
+			{
+				return m_queue->TryPop(pid);
+			}
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(int pid, value_type& outval) noexcept -> bool
+			{
+				return m_queue->TryPop(pid, outval);
+			}
+
+			auto TryPushN(int pid, const value_type* vals, size_type count) noexcept -> size_type
+			{
+				return m_queue->TryPushN(pid, vals, count);
+			}
+			auto TryPopN(int pid, value_type* out, size_type count) noexcept -> size_type
+			{
+				return m_queue->TryPopN(pid, out, count);
+			}
+
+			auto AcquirePid() noexcept -> std::optional<int> { return m_queue->AcquirePid(); }
+			void ReleasePid(int pid) noexcept { m_queue->ReleasePid(pid); }
+
+			// Pid leased to the calling thread by its first call, and released when it exits.
+			auto ThreadPid() -> std::optional<int>
+			{
+				return detail::ThreadPids<lockfree::MPMCQueue<T, Capacity, Layout>>::Get(m_queue);
+			}
+
+			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
+
+			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
+
+		private:
+			std::shared_ptr<lockfree::MPMCQueue<T, Capacity, Layout>> m_queue;
+		};
+
+		class MPMCQueueAny
+		{
+		public:
+			using size_type = lockfree::MPMCQueueAny::size_type;
+
+			MPMCQueueAny(int max_processes, size_type queue_size, const Framing& framing = {})
+				: m_queue(detail::MakeAndInitialize<lockfree::MPMCQueueAny>(
+					  max_processes, queue_size, framing))
+			{
+			}
+
+			auto TryPush(int pid, const void* elem, size_type elemsize) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, elem, elemsize);
+			}
+
+			auto TryPush(int pid, std::string_view elem) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, elem.data(), elem.length());
+			}
+
+			auto TryPop(int pid, void* elem, size_type bufsize) noexcept
+				-> std::optional<size_type>
+			{
+				return m_queue->TryPop(pid, elem, bufsize);
+			}
+
+			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
+
+			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
+
+		private:
+			std::shared_ptr<lockfree::MPMCQueueAny> m_queue;
+		};
+
+		template <typename T, typename Capacity = DynamicCapacity> class MPMCSeqQueue
+		{
+		public:
+			using size_type = std::size_t;
+			using value_type = T;
+
+			MPMCSeqQueue(int max_processes, size_type queue_size)
+				: m_queue(detail::MakeAndInitialize<lockfree::MPMCSeqQueue<T, Capacity>>(
+					  max_processes, queue_size))
+			{
+			}
+
+			auto TryPush(int pid, const value_type& val) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, val);
+			}
+
+			auto TryPop(int pid) noexcept -> std::optional<value_type>
+			{
+				return m_queue->TryPop(pid);
+			}
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(int pid, value_type& outval) noexcept -> bool
+			{
+				return m_queue->TryPop(pid, outval);
+			}
+
+			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
+
+			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
+
+		private:
+			std::shared_ptr<lockfree::MPMCSeqQueue<T, Capacity>> m_queue;
+		};
+
+		template <typename T, typename Capacity = DynamicCapacity> class MPMCWaitFreeQueue
+		{
+		public:
+			using size_type = std::size_t;
+			using value_type = T;
+
+			MPMCWaitFreeQueue(int max_processes, size_type queue_size)
+				: m_queue(detail::MakeAndInitialize<lockfree::MPMCWaitFreeQueue<T, Capacity>>(
+					  max_processes, queue_size))
+			{
+			}
+
+			auto TryPush(int pid, const value_type& val) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, val);
+			}
+
+			auto TryPop(int pid) noexcept -> std::optional<value_type>
+			{
+				return m_queue->TryPop(pid);
+			}
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(int pid, value_type& outval) noexcept -> bool
+			{
+				return m_queue->TryPop(pid, outval);
+			}
+
+			auto TryPushN(int pid, const value_type* vals, size_type count) noexcept -> size_type
+			{
+				return m_queue->TryPushN(pid, vals, count);
+			}
+			auto TryPopN(int pid, value_type* out, size_type count) noexcept -> size_type
+			{
+				return m_queue->TryPopN(pid, out, count);
 			}
 
 			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
@@ -307,7 +1237,7 @@ namespace lockfree
 			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
 
 		private:
-			std::shared_ptr<lockfree::MPMCQueue<T>> m_queue;
+			std::shared_ptr<lockfree::MPMCWaitFreeQueue<T, Capacity>> m_queue;
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <boost/align/align_up.hpp>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <vector>
+
+#include "lockfree-queue/capacity.h"
+#include "lockfree-queue/detail/numa.h"
+#include "lockfree-queue/mpmc.h"
+
+
+namespace lockfree
+{
+	// MPMC queue sharded by NUMA node. Every node has its own `MPMCQueue` of `shard_size`
+	// elements, placed on the node's memory. Producers push into their node's shard, and consumers
+	// pop from their node's shard first, stealing from the other nodes' shards only when it is
+	// empty. So elements are ordered only per shard. On a single node system, it is a plain
+	// `MPMCQueue`.
+	template <typename T, typename Capacity = DynamicCapacity> class MPMCNumaQueue
+	{
+		using shard_type = MPMCQueue<T, Capacity>;
+
+	public:
+		using size_type = std::size_t;
+		using value_type = T;
+
+		// Throws `std::bad_alloc`, if a shard cannot be allocated.
+		MPMCNumaQueue(int max_processes, size_type shard_size)
+			: m_shard_alloc_size(boost::alignment::align_up(
+				  shard_type::CalculateSize(max_processes, shard_size), alignof(shard_type)))
+		{
+			const auto num_nodes = detail::numa_num_nodes();
+
+			m_shards.reserve(num_nodes);
+			for (int node = 0; node < num_nodes; node++)
+			{
+				auto* mem = detail::numa_alloc_onnode(m_shard_alloc_size, node);
+				if (mem == nullptr)
+				{
+					free_shards();
+					throw std::bad_alloc();
+				}
+
+				m_shards.push_back(shard_type::Initialize(mem, max_processes, shard_size));
+			}
+		}
+
+		~MPMCNumaQueue() { free_shards(); }
+
+		MPMCNumaQueue(const MPMCNumaQueue&) = delete;
+		MPMCNumaQueue(MPMCNumaQueue&&) = delete;
+		auto operator=(const MPMCNumaQueue&) -> MPMCNumaQueue& = delete;
+		auto operator=(MPMCNumaQueue&&) -> MPMCNumaQueue& = delete;
+
+		// Returns false, if the shard of the current node is full.
+		auto TryPush(int pid, const value_type& val) noexcept -> bool
+		{
+			return m_shards[current_node()]->TryPush(pid, val);
+		}
+
+		auto TryPop(int pid) noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPop(pid, val))
+				return val;
+
+			return {};
+		}
+
+		// Use this variant to avoid need to double copy.
+		auto TryPop(int pid, value_type& outval) noexcept -> bool
+		{
+			const auto node = current_node();
+
+			for (int i = 0; i < NumNodes(); i++)
+			{
+				if (m_shards[(node + i) % NumNodes()]->TryPop(pid, outval))
+					return true;
+			}
+
+			return false;
+		}
+
+		[[nodiscard]] auto NumNodes() const noexcept -> int { return int(m_shards.size()); }
+
+		auto IsEmpty() noexcept -> bool
+		{
+			for (auto* shard : m_shards)
+			{
+				if (!shard->IsEmpty())
+					return false;
+			}
+
+			return true;
+		}
+
+		// Check if the shard of the current node is full.
+		auto IsFull() noexcept -> bool { return m_shards[current_node()]->IsFull(); }
+
+	private:
+		// Guards against a node coming online after the queue was created.
+		[[nodiscard]] auto current_node() const noexcept -> int
+		{
+			if (NumNodes() == 1)
+				return 0;
+
+			const auto node = detail::numa_current_node();
+			return node < NumNodes() ? node : 0;
+		}
+
+		void free_shards() noexcept
+		{
+			for (auto* shard : m_shards)
+				detail::numa_free(shard, m_shard_alloc_size);
+			m_shards.clear();
+		}
+
+
+		const size_type m_shard_alloc_size;
+		std::vector<shard_type*> m_shards;
+	};
+
+	namespace thread
+	{
+		template <typename T, typename Capacity = DynamicCapacity> class MPMCNumaQueue
+		{
+		public:
+			using size_type = std::size_t;
+			using value_type = T;
+
+			MPMCNumaQueue(int max_processes, size_type shard_size)
+				: m_queue(std::make_shared<lockfree::MPMCNumaQueue<T, Capacity>>(
+					  max_processes, shard_size))
+			{
+			}
+
+			auto TryPush(int pid, const value_type& val) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, val);
+			}
+
+			auto TryPop(int pid) noexcept -> std::optional<value_type>
+			{
+				return m_queue->TryPop(pid);
+			}
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(int pid, value_type& outval) noexcept -> bool
+			{
+				return m_queue->TryPop(pid, outval);
+			}
+
+			[[nodiscard]] auto NumNodes() const noexcept -> int { return m_queue->NumNodes(); }
+
+			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
+
+			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
+
+		private:
+			std::shared_ptr<lockfree::MPMCNumaQueue<T, Capacity>> m_queue;
+		};
+	}
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "lockfree-queue/capacity.h"
+#include "lockfree-queue/detail/defs.h"
+#include "lockfree-queue/mpsc.h"
+
+
+namespace lockfree
+{
+	// MPMC queue partitioned by key. A key is hashed to one of `num_partitions` `MPSCQueue`s, of
+	// `partition_size` elements each, and every partition is owned by one of `num_consumers`
+	// consumers, which alone pops from it. So elements of a key are popped in the order they were
+	// pushed, while the keys are spread over the consumers.
+	// Partitions can be reassigned to another consumer with `Assign`, without draining them. The
+	// new owner takes over once the old one is out of its pop, and carries on from where it
+	// stopped. The number of partitions is fixed, as the per-key order depends on a key always
+	// mapping to the same partition.
+	template <typename T, typename Capacity = DynamicCapacity> class MPMCPartitionedQueue
+	{
+		using partition_queue = MPSCQueue<T, Capacity>;
+
+	public:
+		using size_type = std::size_t;
+		using value_type = T;
+
+		// Partition `p` is owned by the consumer `p % num_consumers` to begin with.
+		MPMCPartitionedQueue(
+			int max_processes, int num_partitions, size_type partition_size, int num_consumers)
+			: m_num_partitions(num_partitions),
+			  m_partitions(std::make_unique<Partition[]>(num_partitions)),
+			  m_consumers(std::make_unique<Consumer[]>(num_consumers))
+		{
+			for (int p = 0; p < num_partitions; p++)
+			{
+				m_partitions[p].queue =
+					detail::MakeAndInitialize<partition_queue>(max_processes, partition_size);
+				m_partitions[p].owner.store(p % num_consumers, std::memory_order_relaxed);
+			}
+		}
+
+		// Partition, the elements of `key` go to.
+		template <typename Key> [[nodiscard]] auto PartitionOf(const Key& key) const noexcept -> int
+		{
+			// Spread the bits of the hash, as the standard hash of integers is the identity.
+			constexpr std::uint64_t MULTIPLIER = 0x9E3779B97F4A7C15;
+			const auto hash = std::uint64_t{ std::hash<Key>{}(key) } * MULTIPLIER;
+
+			return int((hash >> 32U) % std::uint64_t(m_num_partitions));
+		}
+
+		// Returns false, if the partition of `key` is full.
+		template <typename Key>
+		auto TryPush(int pid, const Key& key, const value_type& val) noexcept -> bool
+		{
+			return m_partitions[PartitionOf(key)].queue->TryPush(pid, val);
+		}
+
+		auto TryPop(int consumer) noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPop(consumer, val))
+				return val;
+
+			return {};
+		}
+
+		// Pops from the partitions owned by `consumer`, round robin.
+		// Use this variant to avoid need to double copy.
+		auto TryPop(int consumer, value_type& outval) noexcept -> bool
+		{
+			auto& next = m_consumers[consumer].next_partition;
+
+			for (int i = 0; i < m_num_partitions; i++)
+			{
+				const auto p = (next + i) % m_num_partitions;
+
+				if (try_pop_partition(m_partitions[p], consumer, outval))
+				{
+					next = (p + 1) % m_num_partitions;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		// Hands `partition` over to `consumer`. Elements left in it are popped by `consumer`, in
+		// order, after the ones already popped by the previous owner.
+		void Assign(int partition, int consumer) noexcept
+		{
+			detail::store_release(m_partitions[partition].owner, consumer);
+		}
+
+		[[nodiscard]] auto Owner(int partition) const noexcept -> int
+		{
+			return detail::load_acquire(m_partitions[partition].owner);
+		}
+
+		// Number of elements waiting in `partition`. Only a hint, while the queue is in use.
+		[[nodiscard]] auto Depth(int partition) const noexcept -> size_type
+		{
+			return m_partitions[partition].queue->Size();
+		}
+
+		[[nodiscard]] auto NumPartitions() const noexcept -> int { return m_num_partitions; }
+
+		auto IsEmpty() noexcept -> bool
+		{
+			for (int p = 0; p < m_num_partitions; p++)
+			{
+				if (!m_partitions[p].queue->IsEmpty())
+					return false;
+			}
+
+			return true;
+		}
+
+	private:
+		static constexpr int NO_CONSUMER = -1;
+
+		struct alignas(detail::CACHELINESIZE) Partition
+		{
+			std::shared_ptr<partition_queue> queue;
+			std::atomic<int> owner = NO_CONSUMER;
+			// Consumer inside a pop of `queue`. Serializes the pops of the old and the new owner,
+			// around a reassignment.
+			std::atomic<int> holder = NO_CONSUMER;
+		};
+
+		// Owned by the consumer.
+		struct alignas(detail::CACHELINESIZE) Consumer
+		{
+			int next_partition = 0;
+		};
+
+
+		static auto try_pop_partition(Partition& part, int consumer, value_type& outval) noexcept
+			-> bool
+		{
+			if (detail::load_relaxed(part.owner) != consumer)
+				return false;
+
+			auto holder = NO_CONSUMER;
+			if (!part.holder.compare_exchange_strong(holder, consumer, std::memory_order_acquire))
+				return false;
+
+			// `owner` may have changed before we got hold of it. Acquire, so that the new owner
+			// sees what was done before the `Assign`.
+			const auto popped =
+				detail::load_acquire(part.owner) == consumer && part.queue->TryPop(outval);
+
+			detail::store_release(part.holder, NO_CONSUMER);
+			return popped;
+		}
+
+
+		const int m_num_partitions;
+		const std::unique_ptr<Partition[]> m_partitions;
+		const std::unique_ptr<Consumer[]> m_consumers;
+	};
+
+	namespace thread
+	{
+		template <typename T, typename Capacity = DynamicCapacity> class MPMCPartitionedQueue
+		{
+		public:
+			using size_type = std::size_t;
+			using value_type = T;
+
+			MPMCPartitionedQueue(
+				int max_processes, int num_partitions, size_type partition_size, int num_consumers)
+				: m_queue(std::make_shared<lockfree::MPMCPartitionedQueue<T, Capacity>>(
+					  max_processes, num_partitions, partition_size, num_consumers))
+			{
+			}
+
+			template <typename Key>
+			[[nodiscard]] auto PartitionOf(const Key& key) const noexcept -> int
+			{
+				return m_queue->PartitionOf(key);
+			}
+
+			template <typename Key>
+			auto TryPush(int pid, const Key& key, const value_type& val) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, key, val);
+			}
+
+			auto TryPop(int consumer) noexcept -> std::optional<value_type>
+			{
+				return m_queue->TryPop(consumer);
+			}
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(int consumer, value_type& outval) noexcept -> bool
+			{
+				return m_queue->TryPop(consumer, outval);
+			}
+
+			void Assign(int partition, int consumer) noexcept
+			{
+				m_queue->Assign(partition, consumer);
+			}
+
+			[[nodiscard]] auto Owner(int partition) const noexcept -> int
+			{
+				return m_queue->Owner(partition);
+			}
+
+			[[nodiscard]] auto Depth(int partition) const noexcept -> size_type
+			{
+				return m_queue->Depth(partition);
+			}
+
+			[[nodiscard]] auto NumPartitions() const noexcept -> int
+			{
+				return m_queue->NumPartitions();
+			}
+
+			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
+
+		private:
+			std::shared_ptr<lockfree::MPMCPartitionedQueue<T, Capacity>> m_queue;
+		};
+	}
+}
@@ -1,19 +1,29 @@
 #pragma once
 
+#include <array>
 #include <boost/align/align_up.hpp>
 #include <boost/align/aligned_alloc.hpp>
+#include <cassert>
 #include <cstddef>
 #include <cstring>
 #include <limits>
 #include <memory>
+#include <new>
 #include <optional>
 #include <string_view>
 
 
 #include "lockfree-queue/backoff.h"
+#include "lockfree-queue/capacity.h"
+#include "lockfree-queue/detail/activeset.h"
+#include "lockfree-queue/detail/combining.h"
 #include "lockfree-queue/detail/defs.h"
+#include "lockfree-queue/detail/pidset.h"
 #include "lockfree-queue/detail/ringbuf.h"
 #include "lockfree-queue/detail/scopeexit.h"
+#include "lockfree-queue/framing.h"
+#include "lockfree-queue/layout.h"
+#include "lockfree-queue/lease.h"
 
 
 namespace lockfree
@@ -22,40 +32,106 @@ namespace lockfree
 	{
 	public:
 		using size_type = std::size_t;
+		using WriteRegion = detail::RingBufRegion<char>;
+		using ReadRegion = detail::RingBufRegion<const char>;
 
-		static auto CalculateSize(int max_processes, size_type queue_size) noexcept -> size_type
+		static auto CalculateSize(int max_processes, size_type queue_size,
+			const Framing& /*framing*/ = {}) noexcept -> size_type
 		{
 			auto size = sizeof(MPSCQueueAny);
 
 			size = boost::alignment::align_up(size, alignof(ThreadPos));
 			size += sizeof(ThreadPos) * max_processes;
+			size = boost::alignment::align_up(size, alignof(detail::ActiveWord));
+			size += detail::active_set_size(max_processes);
+			size = boost::alignment::align_up(size, alignof(detail::PidWord));
+			size += detail::pid_set_size(max_processes);
 
 			return boost::alignment::align_up(size, alignof(MPSCQueueAny)) + queue_size;
 		}
 
-		static auto Initialize(void* queue_ptr, int max_processes, size_type queue_size) noexcept
-			-> MPSCQueueAny*
+		// `queue_size` must be a multiple of `framing.PayloadAlignment()`.
+		static auto Initialize(void* queue_ptr, int max_processes, size_type queue_size,
+			const Framing& framing = {}) noexcept -> MPSCQueueAny*
+		{
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			return new (static_cast<MPSCQueueAny*>(queue_ptr))
+				MPSCQueueAny(max_processes, queue_size, framing);
+		}
+
+		// Ring buffer is mapped twice back to back, so that no element is ever split.
+		// `queue_size` is rounded up to a multiple of the page size.
+		static auto CalculateMirroredLayout(int max_processes, size_type queue_size,
+			const Framing& /*framing*/ = {}) noexcept -> detail::MirroredLayout
+		{
+			const auto page_size = detail::page_size();
+			const auto data_offset = CalculateSize(max_processes, 0);
+			const auto header_size = boost::alignment::align_up(data_offset, page_size);
+
+			return { header_size, boost::alignment::align_up(queue_size, page_size), 1,
+				header_size - data_offset };
+		}
+
+		static auto InitializeMirrored(void* queue_ptr, int max_processes, size_type queue_size,
+			const Framing& framing = {}) noexcept -> MPSCQueueAny*
 		{
+			const auto layout = CalculateMirroredLayout(max_processes, queue_size);
+
 			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
 			return new (static_cast<MPSCQueueAny*>(queue_ptr))
-				MPSCQueueAny(max_processes, queue_size);
+				MPSCQueueAny(max_processes, layout.ring_size, framing, true);
 		}
 
 
 		auto TryPush(int pid, const void* elem, size_type elemsize) noexcept -> bool
 		{
-			SCOPE_EXIT([&] { detail::store_release(get_tpos_data()[pid].head, INVALID_Q_POS); });
+			detail::set_active(get_active_data(), m_max_processes, pid);
+			SCOPE_EXIT([&] {
+				detail::store_release(get_tpos_data()[pid].head, INVALID_Q_POS);
+				detail::clear_active(get_active_data(), m_max_processes, pid);
+			});
 
-			if (auto head = reserve_head_to_produce(pid, elemsize + sizeof(size_type)))
+			if (auto head = reserve_head_to_produce(pid, elemsize))
 			{
 				detail::copy_elem_into_ringbuf(
-					get_queue_data(), m_queue_size, *head, elem, elemsize);
+					get_queue_data(), m_capacity, m_mirrored, m_framing, *head, elem, elemsize);
 				return true;
 			}
 
 			return false;
 		}
 
+		// Reserve `elemsize` bytes inside the queue, for the element to be written in place.
+		// Nothing from this or the later reservations of other producers is visible to the
+		// consumer until `Commit`, so it must follow soon. A reservation can't be dropped.
+		auto Reserve(int pid, size_type elemsize) noexcept -> std::optional<WriteRegion>
+		{
+			detail::set_active(get_active_data(), m_max_processes, pid);
+
+			if (auto head = reserve_head_to_produce(pid, elemsize))
+			{
+				char header[sizeof(std::uint64_t)];
+
+				m_framing.StoreHeader(header, elemsize);
+				detail::copy_into_ringbuf(get_queue_data(), m_capacity, m_mirrored,
+					m_framing.HeaderPos(*head), header, m_framing.HeaderSize());
+
+				return detail::get_ringbuf_region(get_queue_data(), m_capacity, m_mirrored,
+					m_framing.PayloadPos(*head), elemsize);
+			}
+
+			// Nothing was reserved, only the published position is reset.
+			Commit(pid);
+			return {};
+		}
+
+		// Publish the element reserved by the last `Reserve` of `pid`.
+		void Commit(int pid) noexcept
+		{
+			detail::store_release(get_tpos_data()[pid].head, INVALID_Q_POS);
+			detail::clear_active(get_active_data(), m_max_processes, pid);
+		}
+
 
 		auto GetNextElementSize() noexcept -> std::optional<size_type>
 		{
@@ -69,9 +145,9 @@ namespace lockfree
 
 			if (auto elemsize = get_next_elem_size())
 			{
-				detail::copy_out_of_ringbuf(get_queue_data(), m_queue_size,
-					tail + sizeof(size_type), elem, std::min(req_elemsize, *elemsize));
-				detail::store_release(m_tail, tail + *elemsize + sizeof(size_type));
+				detail::copy_out_of_ringbuf(get_queue_data(), m_capacity, m_mirrored,
+					m_framing.PayloadPos(tail), elem, std::min(req_elemsize, *elemsize));
+				detail::store_release(m_tail, m_framing.ElemEnd(tail, *elemsize));
 				return true;
 			}
 
@@ -85,8 +161,8 @@ namespace lockfree
 
 			if (auto elemsize = get_next_elem_size())
 			{
-				detail::copy_out_of_ringbuf(get_queue_data(), m_queue_size,
-					tail + sizeof(size_type), elem, std::min(req_elemsize, *elemsize));
+				detail::copy_out_of_ringbuf(get_queue_data(), m_capacity, m_mirrored,
+					m_framing.PayloadPos(tail), elem, std::min(req_elemsize, *elemsize));
 				return true;
 			}
 
@@ -94,10 +170,42 @@ namespace lockfree
 		}
 
 		// `elem` must be allocated to atleast `GetNextElementSize` bytes
-		auto TryPop(void* elem) noexcept -> bool { return TryPop(elem, m_queue_size); }
+		auto TryPop(void* elem) noexcept -> bool { return TryPop(elem, m_capacity.Size()); }
 
 		// `elem` must be allocated to atleast `GetNextElementSize` bytes
-		auto TryPeek(void* elem) noexcept -> bool { return TryPeek(elem, m_queue_size); }
+		auto TryPeek(void* elem) noexcept -> bool { return TryPeek(elem, m_capacity.Size()); }
+
+		// Get a read-only view of the front element inside the queue, without copying it out.
+		// The view stays valid until `Consume`.
+		auto TryRead() noexcept -> std::optional<ReadRegion>
+		{
+			if (auto elemsize = get_next_elem_size())
+			{
+				return detail::get_ringbuf_region(static_cast<const char*>(get_queue_data()),
+					m_capacity, m_mirrored, m_framing.PayloadPos(detail::load_acquire(m_tail)),
+					*elemsize);
+			}
+
+			return {};
+		}
+
+		// Pop the element viewed by the last `TryRead`.
+		void Consume() noexcept
+		{
+			auto tail = detail::load_acquire(m_tail);
+			auto elemsize =
+				detail::read_elem_size(get_queue_data(), m_capacity, m_mirrored, m_framing, tail);
+
+			detail::store_release(m_tail, m_framing.ElemEnd(tail, elemsize));
+		}
+
+		// Leases a free pid, for the callers which can't assign pids themselves. Returns nullopt,
+		// if all the pids are leased. Must not be mixed with pids assigned by the caller.
+		auto AcquirePid() noexcept -> std::optional<int>
+		{
+			return detail::acquire_pid(get_pid_set(), m_max_processes);
+		}
+		void ReleasePid(int pid) noexcept { detail::release_pid(get_pid_set(), pid); }
 
 		auto IsEmpty() noexcept -> bool
 		{
@@ -128,12 +236,19 @@ namespace lockfree
 			std::atomic<size_type> head = INVALID_Q_POS;
 		};
 
-		MPSCQueueAny(int max_processes, size_type queue_size) noexcept
-			: m_max_processes(max_processes), m_queue_size(queue_size)
+		MPSCQueueAny(int max_processes, size_type queue_size, const Framing& framing,
+			bool mirrored = false) noexcept
+			: m_max_processes(max_processes), m_capacity(queue_size), m_framing(framing),
+			  m_mirrored(mirrored)
 		{
+			assert(queue_size % framing.PayloadAlignment() == 0);
+
 			auto* tpos = get_tpos_data();
 			for (int i = 0; i < max_processes; i++)
 				new (&tpos[i]) ThreadPos{};
+
+			detail::init_active_set(get_active_data(), max_processes);
+			detail::init_pid_set(get_pid_set(), max_processes);
 		}
 
 
@@ -142,11 +257,9 @@ namespace lockfree
 			auto last_head = detail::load_acquire(m_head);
 			const auto* tpos = get_tpos_data();
 
-			for (int i = 0; i < m_max_processes; i++)
-			{
-				auto head = detail::load_acquire(tpos[i].head);
-				last_head = std::min(last_head, head);
-			}
+			detail::for_each_active(get_active_data(), m_max_processes, [&](int pid) {
+				last_head = std::min(last_head, detail::load_acquire(tpos[pid].head));
+			});
 
 			if (last_head > old_last_head &&
 				!m_last_head.compare_exchange_strong(old_last_head, last_head) &&
@@ -157,6 +270,7 @@ namespace lockfree
 		}
 
 
+		// `elemsize` is the payload's size. Padding and header are added, as per `m_framing`.
 		auto reserve_head_to_produce(int pid, size_type elemsize) noexcept
 			-> std::optional<size_type>
 		{
@@ -165,11 +279,11 @@ namespace lockfree
 			auto* tpos = get_tpos_data();
 			ExponentialBackoff backoff;
 
-			while (!is_full(head, last_tail, elemsize))
+			while (!is_full(head, last_tail, m_framing.ElemEnd(head, elemsize) - head))
 			{
 				detail::store_release(tpos[pid].head, head);
 
-				if (m_head.compare_exchange_strong(head, head + elemsize))
+				if (m_head.compare_exchange_strong(head, m_framing.ElemEnd(head, elemsize)))
 					return head;
 
 				backoff();
@@ -188,11 +302,8 @@ namespace lockfree
 
 			if (!is_empty(last_head, tail))
 			{
-				size_type elemsize;
-
-				detail::copy_out_of_ringbuf(
-					get_queue_data(), m_queue_size, tail, &elemsize, sizeof(size_type));
-				return elemsize;
+				return detail::read_elem_size(
+					get_queue_data(), m_capacity, m_mirrored, m_framing, tail);
 			}
 
 			if constexpr (TryAgain)
@@ -208,7 +319,7 @@ namespace lockfree
 		[[nodiscard]] auto is_full(
 			size_type head, size_type tail, size_type elemsize) const noexcept -> bool
 		{
-			return head + elemsize - 1 >= tail + m_queue_size;
+			return head + elemsize - 1 >= tail + m_capacity.Size();
 		}
 		static auto is_empty(size_type head, size_type tail) noexcept -> bool
 		{
@@ -228,11 +339,25 @@ namespace lockfree
 			return const_cast<MPSCQueueAny*>(this)->get_tpos_data();
 		}
 
-		auto get_queue_data() noexcept -> char*
+		auto get_active_data() noexcept -> detail::ActiveWord*
 		{
 			auto* p = reinterpret_cast<char*>(get_tpos_data());
+			return static_cast<detail::ActiveWord*>(boost::alignment::align_up(
+				p + sizeof(ThreadPos) * m_max_processes, alignof(detail::ActiveWord)));
+		}
+
+		auto get_pid_set() noexcept -> detail::PidWord*
+		{
+			auto* p = reinterpret_cast<char*>(get_active_data());
+			return static_cast<detail::PidWord*>(boost::alignment::align_up(
+				p + detail::active_set_size(m_max_processes), alignof(detail::PidWord)));
+		}
+
+		auto get_queue_data() noexcept -> char*
+		{
+			auto* p = reinterpret_cast<char*>(get_pid_set());
 			return static_cast<char*>(boost::alignment::align_up(
-				p + sizeof(ThreadPos) * m_max_processes, detail::CACHELINESIZE));
+				p + detail::pid_set_size(m_max_processes), detail::CACHELINESIZE));
 		}
 		[[nodiscard]] auto get_queue_data() const noexcept -> const char*
 		{
@@ -242,7 +367,9 @@ namespace lockfree
 
 
 		const int m_max_processes;
-		const size_type m_queue_size;
+		const DynamicCapacity m_capacity;
+		const Framing m_framing;
+		const bool m_mirrored;
 
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
@@ -251,28 +378,45 @@ namespace lockfree
 
 	static_assert(std::is_trivially_copyable_v<MPSCQueueAny>);
 
-	template <typename T> class MPSCQueue
+	// When `MaxProcesses` isn't 0, `max_processes` must be equal to it and the producer slots are
+	// scanned with a compile time bound. `Layout` is one of the policies in
+	// "lockfree-queue/layout.h".
+	template <typename T, typename Capacity = DynamicCapacity, int MaxProcesses = 0,
+		typename Layout = DenseLayout>
+	class MPSCQueue
 	{
 		static_assert(std::is_trivial_v<T>, "Type must be trivial to be store inside queue");
 
+		using slot_type = typename Layout::template Slot<T>;
+
 	public:
 		using size_type = std::size_t;
 		using value_type = T;
 
-		static auto GetAlignment() noexcept -> size_type
+		static constexpr auto GetAlignment() noexcept -> size_type
 		{
-			return std::max({ alignof(MPSCQueue), alignof(T), detail::CACHELINESIZE });
+			return std::max({ alignof(MPSCQueue), alignof(slot_type), detail::CACHELINESIZE });
 		}
 
-		static auto CalculateSize(int max_processes, size_type queue_size) noexcept -> size_type
+		static constexpr auto CalculateSize(int max_processes, size_type queue_size) noexcept
+			-> size_type
 		{
 			auto size = sizeof(MPSCQueue);
 
 			size = boost::alignment::align_up(size, alignof(ThreadPos));
 			size += sizeof(ThreadPos) * max_processes;
-
-			return boost::alignment::align_up(size, std::max(detail::CACHELINESIZE, alignof(T))) +
-				   queue_size * sizeof(value_type);
+			size = boost::alignment::align_up(size, alignof(detail::ActiveWord));
+			size += detail::active_set_size(max_processes);
+			size = boost::alignment::align_up(size, alignof(detail::PidWord));
+			size += detail::pid_set_size(max_processes);
+			size = boost::alignment::align_up(size, alignof(Hole));
+			size += sizeof(Hole) * max_processes;
+			size = boost::alignment::align_up(size, alignof(detail::CombineSlot<T>));
+			size += sizeof(detail::CombineSlot<T>) * max_processes;
+
+			return boost::alignment::align_up(
+					   size, std::max(detail::CACHELINESIZE, alignof(slot_type))) +
+				   queue_size * sizeof(slot_type);
 		}
 
 		static auto Initialize(void* queue_ptr, int max_processes, size_type queue_size) noexcept
@@ -286,15 +430,40 @@ namespace lockfree
 
 		auto TryPush(int pid, const value_type& val) noexcept -> bool
 		{
-			SCOPE_EXIT([&] { detail::store_release(get_tpos_data()[pid].head, INVALID_Q_POS); });
+			return TryPushN(pid, &val, 1) == 1;
+		}
+
+		// Reserves the slots for upto `count` elements at once. Returns the number pushed.
+		auto TryPushN(int pid, const value_type* vals, size_type count) noexcept -> size_type
+		{
+			detail::set_active(get_active_data(), max_processes(), pid);
+			SCOPE_EXIT([&] {
+				detail::store_release(get_tpos_data()[pid].head, INVALID_Q_POS);
+				detail::clear_active(get_active_data(), max_processes(), pid);
+			});
 
-			if (auto head = reserve_head_to_produce(pid))
+			if (auto head = reserve_head_to_produce(pid, count))
 			{
-				get_queue_data()[*head % m_queue_size] = val;
-				return true;
+				detail::copy_into_ring<Layout>(get_queue_data(), m_capacity, *head, vals, count);
+				return count;
 			}
 
-			return false;
+			return 0;
+		}
+
+		// Flat combining variant of `TryPush`, for heavily contended queues. Element is published
+		// in the producer's slot, and whichever producer takes the combiner role pushes all the
+		// published elements at once, with a single head update.
+		auto TryPushCombined(int pid, const value_type& val) noexcept -> bool
+		{
+			auto* slots = get_combine_slots();
+
+			return detail::combine_push(
+				m_combining, max_processes(), pid, val,
+				[slots](int i) -> detail::CombineSlot<T>& { return slots[i]; },
+				[&](const value_type* vals, size_type count) {
+					return TryPushN(pid, vals, count);
+				});
 		}
 
 		auto TryPop() noexcept -> std::optional<value_type>
@@ -302,7 +471,7 @@ namespace lockfree
 			if (auto tail = get_tail())
 			{
 				SCOPE_EXIT([&] { detail::store_release(m_tail, *tail + 1); });
-				return get_queue_data()[*tail % m_queue_size];
+				return get_elem(*tail);
 			}
 
 			return {};
@@ -314,16 +483,38 @@ namespace lockfree
 			if (auto tail = get_tail())
 			{
 				SCOPE_EXIT([&] { detail::store_release(m_tail, *tail + 1); });
-				outval = get_queue_data()[*tail % m_queue_size];
+				outval = get_elem(*tail);
 				return true;
 			}
 			return false;
 		}
 
+		// Pops upto `count` elements, advancing the tail once. Returns the number popped.
+		auto TryPopN(value_type* out, size_type count) noexcept -> size_type
+		{
+			auto last_head = detail::load_acquire(m_last_head);
+			auto tail = detail::load_acquire(m_tail);
+
+			if (last_head - tail < count)
+			{
+				update_last_head(last_head);
+				last_head = detail::load_acquire(m_last_head);
+			}
+
+			count = std::min(count, last_head - tail);
+			if (count != 0)
+			{
+				detail::copy_out_of_ring<Layout>(get_queue_data(), m_capacity, tail, out, count);
+				detail::store_release(m_tail, tail + count);
+			}
+
+			return count;
+		}
+
 		auto TryPeek() noexcept -> std::optional<value_type>
 		{
 			if (auto tail = get_tail())
-				return get_queue_data()[*tail % m_queue_size];
+				return get_elem(*tail);
 
 			return {};
 		}
@@ -333,12 +524,67 @@ namespace lockfree
 		{
 			if (auto tail = get_tail())
 			{
-				outval = get_queue_data()[*tail % m_queue_size];
+				outval = get_elem(*tail);
 				return true;
 			}
 			return false;
 		}
 
+		// Relaxed order variant of `TryPop`. When the element at tail is reserved by a producer,
+		// which hasn't finished writing it (e.g. was descheduled), the reservation is skipped and
+		// the elements committed after it are popped. Skipped reservations are popped as soon as
+		// they are committed. Elements of a producer are still popped in the order it pushed them.
+		// Tail isn't advanced past a skipped reservation, so the slots popped out of order are
+		// reused only after it is popped. Must not be mixed with the other pops and peeks.
+		auto TryPopUnordered(value_type& outval) noexcept -> bool
+		{
+			if (m_num_holes == 0)
+				m_skip_pos = detail::load_acquire(m_tail);
+
+			for (;;)
+			{
+				if (m_skip_pos >= m_skip_bound)
+					m_skip_bound = get_committed_head(m_skip_pos);
+
+				// Checked only after the bound, so that the skipped reservation of a producer is
+				// seen as committed, if its later elements are.
+				if (m_num_holes != 0 && is_hole_committed())
+				{
+					outval = get_elem(detail::load_acquire(m_tail));
+					pop_hole();
+					return true;
+				}
+
+				if (m_skip_pos < m_skip_bound)
+				{
+					outval = get_elem(m_skip_pos++);
+					if (m_num_holes == 0)
+						detail::store_release(m_tail, m_skip_pos);
+					return true;
+				}
+
+				if (!skip_hole())
+					return false;
+			}
+		}
+
+		auto TryPopUnordered() noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPopUnordered(val))
+				return val;
+
+			return {};
+		}
+
+		// Leases a free pid, for the callers which can't assign pids themselves. Returns nullopt,
+		// if all the pids are leased. Must not be mixed with pids assigned by the caller.
+		auto AcquirePid() noexcept -> std::optional<int>
+		{
+			return detail::acquire_pid(get_pid_set(), max_processes());
+		}
+		void ReleasePid(int pid) noexcept { detail::release_pid(get_pid_set(), pid); }
+
 		auto IsEmpty() noexcept -> bool
 		{
 			size_type last_head;
@@ -360,20 +606,47 @@ namespace lockfree
 			return is_full(detail::load_acquire(m_head), detail::load_acquire(m_tail));
 		}
 
+		// Number of elements pushed, or being pushed, and not yet popped. It's only a hint, while
+		// the queue is in use.
+		[[nodiscard]] auto Size() const noexcept -> size_type
+		{
+			const auto tail = detail::load_acquire(m_tail);
+			return detail::load_acquire(m_head) - tail;
+		}
+
 	private:
 		static constexpr auto INVALID_Q_POS = std::numeric_limits<size_type>::max();
 
 		struct alignas(detail::CACHELINESIZE) ThreadPos
 		{
 			std::atomic<size_type> head = INVALID_Q_POS;
+			// End of the last reservation. Valid only when it is past `head`.
+			std::atomic<size_type> end = 0;
+		};
+
+		// Reservation skipped by `TryPopUnordered`. Owned by the consumer.
+		struct Hole
+		{
+			size_type start;
+			size_type end;
+			int pid;
 		};
 
 		MPSCQueue(int max_processes, size_type queue_size) noexcept
-			: m_max_processes(max_processes), m_queue_size(queue_size)
+			: m_max_processes(max_processes), m_capacity(queue_size)
 		{
+			assert(MaxProcesses == 0 || max_processes == MaxProcesses);
+
 			auto* tpos = get_tpos_data();
+			auto* slots = get_combine_slots();
 			for (int i = 0; i < max_processes; i++)
+			{
 				new (&tpos[i]) ThreadPos{};
+				new (&slots[i]) detail::CombineSlot<T>{};
+			}
+
+			detail::init_active_set(get_active_data(), max_processes);
+			detail::init_pid_set(get_pid_set(), max_processes);
 		}
 
 
@@ -382,11 +655,9 @@ namespace lockfree
 			auto last_head = detail::load_acquire(m_head);
 			const auto* tpos = get_tpos_data();
 
-			for (int i = 0; i < m_max_processes; i++)
-			{
-				auto head = detail::load_acquire(tpos[i].head);
-				last_head = std::min(last_head, head);
-			}
+			detail::for_each_active(get_active_data(), max_processes(), [&](int pid) {
+				last_head = std::min(last_head, detail::load_acquire(tpos[pid].head));
+			});
 
 			if (last_head > old_last_head &&
 				!m_last_head.compare_exchange_strong(old_last_head, last_head) &&
@@ -397,19 +668,28 @@ namespace lockfree
 		}
 
 
-		auto reserve_head_to_produce(int pid) noexcept -> std::optional<size_type>
+		// Reserves upto `count` slots, starting at the returned position, in one step. `count` is
+		// set to the number reserved.
+		auto reserve_head_to_produce(int pid, size_type& count) noexcept
+			-> std::optional<size_type>
 		{
 			auto head = detail::load_acquire(m_head);
 			auto last_tail = detail::load_acquire(m_tail);
 			auto* tpos = get_tpos_data();
 			ExponentialBackoff backoff;
 
-			while (!is_full(head, last_tail))
+			while (count != 0 && !is_full(head, last_tail))
 			{
+				const auto reserved = std::min(count, last_tail + m_capacity.Size() - head);
+
 				detail::store_release(tpos[pid].head, head);
 
-				if (m_head.compare_exchange_strong(head, head + 1))
+				if (m_head.compare_exchange_strong(head, head + reserved))
+				{
+					detail::store_release(tpos[pid].end, head + reserved);
+					count = reserved;
 					return head;
+				}
 
 				backoff();
 
@@ -438,15 +718,88 @@ namespace lockfree
 		}
 
 
+		// Positions from `pos` upto the returned one are committed. Reservations starting before
+		// `pos` are either skipped already or bound to fail.
+		auto get_committed_head(size_type pos) noexcept -> size_type
+		{
+			auto head = detail::load_acquire(m_head);
+			const auto* tpos = get_tpos_data();
+
+			detail::for_each_active(get_active_data(), max_processes(), [&](int pid) {
+				if (auto phead = detail::load_acquire(tpos[pid].head); phead >= pos)
+					head = std::min(head, phead);
+			});
+
+			return head;
+		}
+
+		// Record the reservation at `m_skip_pos` as a hole and move past it. Fails, if no
+		// reservation starts there, its end isn't published yet, or there are too many holes.
+		auto skip_hole() noexcept -> bool
+		{
+			const auto* tpos = get_tpos_data();
+			auto pos = m_skip_pos;
+
+			if (m_num_holes == max_processes())
+				return false;
+
+			detail::for_each_active(get_active_data(), max_processes(), [&](int pid) {
+				if (pos != m_skip_pos || detail::load_acquire(tpos[pid].head) != pos)
+					return;
+
+				// Previous reservations of `pid` end at or before `pos`, so a later end is this
+				// reservation's, as long as `pid` is still at `pos`.
+				auto end = detail::load_acquire(tpos[pid].end);
+				if (end > pos && detail::load_acquire(tpos[pid].head) == pos)
+				{
+					auto* holes = get_holes();
+					holes[(m_first_hole + m_num_holes++) % max_processes()] = { pos, end, pid };
+					m_skip_pos = end;
+				}
+			});
+
+			return pos != m_skip_pos;
+		}
+
+		[[nodiscard]] auto is_hole_committed() noexcept -> bool
+		{
+			const auto& hole = get_holes()[m_first_hole];
+			return detail::load_acquire(get_tpos_data()[hole.pid].head) != hole.start;
+		}
+
+		// Pop the element at tail, which is inside the first hole.
+		void pop_hole() noexcept
+		{
+			const auto* holes = get_holes();
+			auto tail = detail::load_acquire(m_tail) + 1;
+
+			if (tail == holes[m_first_hole].end)
+			{
+				m_first_hole = (m_first_hole + 1) % max_processes();
+				tail = --m_num_holes != 0 ? holes[m_first_hole].start : m_skip_pos;
+			}
+
+			detail::store_release(m_tail, tail);
+		}
+
+
 		[[nodiscard]] auto is_full(size_type head, size_type tail) const noexcept -> bool
 		{
-			return head >= tail + m_queue_size;
+			return head >= tail + m_capacity.Size();
 		}
 		static auto is_empty(size_type head, size_type tail) noexcept -> bool
 		{
 			return tail >= head;
 		}
 
+		[[nodiscard]] auto max_processes() const noexcept -> int
+		{
+			if constexpr (MaxProcesses != 0)
+				return MaxProcesses;
+			else
+				return m_max_processes;
+		}
+
 
 		auto get_tpos_data() noexcept -> ThreadPos*
 		{
@@ -460,25 +813,217 @@ namespace lockfree
 			return const_cast<MPSCQueue*>(this)->get_tpos_data();
 		}
 
-		auto get_queue_data() noexcept -> T*
+		auto get_active_data() noexcept -> detail::ActiveWord*
 		{
 			auto* p = reinterpret_cast<char*>(get_tpos_data());
-			return static_cast<T*>(boost::alignment::align_up(
-				p + sizeof(ThreadPos) * m_max_processes, detail::CACHELINESIZE));
+			return static_cast<detail::ActiveWord*>(boost::alignment::align_up(
+				p + sizeof(ThreadPos) * max_processes(), alignof(detail::ActiveWord)));
+		}
+
+		auto get_pid_set() noexcept -> detail::PidWord*
+		{
+			auto* p = reinterpret_cast<char*>(get_active_data());
+			return static_cast<detail::PidWord*>(boost::alignment::align_up(
+				p + detail::active_set_size(max_processes()), alignof(detail::PidWord)));
+		}
+
+		auto get_holes() noexcept -> Hole*
+		{
+			auto* p = reinterpret_cast<char*>(get_pid_set());
+			return static_cast<Hole*>(boost::alignment::align_up(
+				p + detail::pid_set_size(max_processes()), alignof(Hole)));
 		}
-		[[nodiscard]] auto get_queue_data() const noexcept -> const T*
+
+		auto get_combine_slots() noexcept -> detail::CombineSlot<T>*
+		{
+			auto* p = reinterpret_cast<char*>(get_holes());
+			return static_cast<detail::CombineSlot<T>*>(boost::alignment::align_up(
+				p + sizeof(Hole) * max_processes(), alignof(detail::CombineSlot<T>)));
+		}
+
+		auto get_queue_data() noexcept -> slot_type*
+		{
+			auto* p = reinterpret_cast<char*>(get_combine_slots());
+			return static_cast<slot_type*>(boost::alignment::align_up(
+				p + sizeof(detail::CombineSlot<T>) * max_processes(), detail::CACHELINESIZE));
+		}
+		[[nodiscard]] auto get_queue_data() const noexcept -> const slot_type*
 		{
 			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
 			return const_cast<MPSCQueue*>(this)->get_queue_data();
 		}
 
+		// Element at queue position `pos`.
+		auto get_elem(size_type pos) noexcept -> value_type&
+		{
+			return Layout::Value(get_queue_data()[m_capacity.Wrap(pos)]);
+		}
+
 
 		const int m_max_processes;
-		const size_type m_queue_size;
+		const Capacity m_capacity;
 
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_last_head = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<bool> m_combining = false;
+
+		// State of `TryPopUnordered`, owned by the consumer. Positions before `m_skip_pos` are
+		// popped, except the ones in the holes, which start at `m_tail`.
+		alignas(detail::CACHELINESIZE) size_type m_skip_pos = 0;
+		size_type m_skip_bound = 0;
+		int m_first_hole = 0;
+		int m_num_holes = 0;
+	};
+
+	// Same interface as `MPSCQueue`, but producers never retry. A push takes a credit and claims
+	// its slot with one `fetch_add` each, and marks the slot ready through its sequence number.
+	// Consumer checks readiness of the slot at tail, instead of scanning the producers' positions.
+	// `max_processes` is accepted only for compatibility and `pid` is ignored.
+	template <typename T, typename Capacity = DynamicCapacity> class MPSCSeqQueue
+	{
+		static_assert(std::is_trivial_v<T>, "Type must be trivial to be store inside queue");
+
+	public:
+		using size_type = std::size_t;
+		using value_type = T;
+
+		static constexpr auto GetAlignment() noexcept -> size_type
+		{
+			return std::max({ alignof(MPSCSeqQueue), alignof(Slot), detail::CACHELINESIZE });
+		}
+
+		static constexpr auto CalculateSize(int /*max_processes*/, size_type queue_size) noexcept
+			-> size_type
+		{
+			return boost::alignment::align_up(sizeof(MPSCSeqQueue), alignof(Slot)) +
+				   queue_size * sizeof(Slot);
+		}
+
+		static auto Initialize(void* queue_ptr, int /*max_processes*/,
+			size_type queue_size) noexcept -> MPSCSeqQueue*
+		{
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			return new (static_cast<MPSCSeqQueue*>(queue_ptr)) MPSCSeqQueue(queue_size);
+		}
+
+		static void Destroy(MPSCSeqQueue* ptr) noexcept { std::destroy_at(ptr); }
+
+		auto TryPush(int /*pid*/, const value_type& val) noexcept -> bool
+		{
+			if (detail::load_relaxed(m_credits) <= 0)
+				return false;
+
+			if (m_credits.fetch_sub(1) <= 0)
+			{
+				m_credits.fetch_add(1);
+				return false;
+			}
+
+			// Credits bound the claimed, but not yet popped, slots to the capacity. So the slot's
+			// previous element is already popped.
+			const auto head = m_head.fetch_add(1);
+			auto& slot = get_slots()[m_capacity.Wrap(head)];
+
+			assert(detail::load_acquire(slot.seq) == head);
+			slot.value = val;
+			detail::store_release(slot.seq, head + 1);
+
+			return true;
+		}
+
+		auto TryPop() noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPop(val))
+				return val;
+
+			return {};
+		}
+
+		// Use this variant to avoid need to double copy.
+		auto TryPop(value_type& outval) noexcept -> bool
+		{
+			const auto tail = detail::load_relaxed(m_tail);
+			auto& slot = get_slots()[m_capacity.Wrap(tail)];
+
+			if (!is_ready(slot, tail))
+				return false;
+
+			outval = slot.value;
+			detail::store_release(slot.seq, tail + m_capacity.Size());
+			detail::store_release(m_tail, tail + 1);
+			m_credits.fetch_add(1);
+
+			return true;
+		}
+
+		auto TryPeek() noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPeek(val))
+				return val;
+
+			return {};
+		}
+
+		// Use this variant to avoid need to double copy.
+		auto TryPeek(value_type& outval) noexcept -> bool
+		{
+			const auto tail = detail::load_relaxed(m_tail);
+			const auto& slot = get_slots()[m_capacity.Wrap(tail)];
+
+			if (!is_ready(slot, tail))
+				return false;
+
+			outval = slot.value;
+			return true;
+		}
+
+		// Element at tail may still be being written, even if later ones are complete.
+		auto IsEmpty() noexcept -> bool
+		{
+			const auto tail = detail::load_acquire(m_tail);
+			return !is_ready(get_slots()[m_capacity.Wrap(tail)], tail);
+		}
+
+		auto IsFull() noexcept -> bool { return detail::load_acquire(m_credits) <= 0; }
+
+	private:
+		// `seq` is `pos` when the slot is free for the element at `pos`, and `pos + 1` once the
+		// element is written.
+		struct Slot
+		{
+			std::atomic<size_type> seq;
+			value_type value;
+		};
+
+		explicit MPSCSeqQueue(size_type queue_size) noexcept
+			: m_capacity(queue_size), m_credits(static_cast<std::ptrdiff_t>(queue_size))
+		{
+			auto* slots = get_slots();
+			for (size_type i = 0; i < queue_size; i++)
+				new (&slots[i]) Slot{ i, {} };
+		}
+
+		static auto is_ready(const Slot& slot, size_type pos) noexcept -> bool
+		{
+			return detail::load_acquire(slot.seq) == pos + 1;
+		}
+
+		auto get_slots() noexcept -> Slot*
+		{
+			auto* p = reinterpret_cast<char*>(this);
+			return reinterpret_cast<Slot*>(
+				boost::alignment::align_up(p + sizeof(MPSCSeqQueue), alignof(Slot)));
+		}
+
+
+		const Capacity m_capacity;
+
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
+		alignas(detail::CACHELINESIZE) std::atomic<std::ptrdiff_t> m_credits;
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
 	};
 
 	namespace thread
@@ -487,10 +1032,15 @@ namespace lockfree
 		{
 		public:
 			using size_type = std::size_t;
-
-			MPSCQueueAny(int max_processes, size_type queue_size)
-				: m_queue(
-					  detail::MakeAndInitialize<lockfree::MPSCQueueAny>(max_processes, queue_size))
+			using WriteRegion = lockfree::MPSCQueueAny::WriteRegion;
+			using ReadRegion = lockfree::MPSCQueueAny::ReadRegion;
+
+			MPSCQueueAny(int max_processes, size_type queue_size, bool mirrored = false,
+				const Framing& framing = {})
+				: m_queue(mirrored ? detail::MakeAndInitializeMirrored<lockfree::MPSCQueueAny>(
+										 max_processes, queue_size, framing)
+								   : detail::MakeAndInitialize<lockfree::MPSCQueueAny>(
+										 max_processes, queue_size, framing))
 			{
 			}
 
@@ -505,6 +1055,12 @@ namespace lockfree
 				return m_queue->TryPush(pid, elem.data(), elem.length());
 			}
 
+			auto Reserve(int pid, size_type elemsize) noexcept -> std::optional<WriteRegion>
+			{
+				return m_queue->Reserve(pid, elemsize);
+			}
+			void Commit(int pid) noexcept { m_queue->Commit(pid); }
+
 			auto GetNextElementSize() noexcept -> std::optional<size_type>
 			{
 				return m_queue->GetNextElementSize();
@@ -522,6 +1078,18 @@ namespace lockfree
 				return m_queue->TryPeek(elem, req_elemsize);
 			}
 
+			auto TryRead() noexcept -> std::optional<ReadRegion> { return m_queue->TryRead(); }
+			void Consume() noexcept { m_queue->Consume(); }
+
+			auto AcquirePid() noexcept -> std::optional<int> { return m_queue->AcquirePid(); }
+			void ReleasePid(int pid) noexcept { m_queue->ReleasePid(pid); }
+
+			// Pid leased to the calling thread by its first call, and released when it exits.
+			auto ThreadPid() -> std::optional<int>
+			{
+				return detail::ThreadPids<lockfree::MPSCQueueAny>::Get(m_queue);
+			}
+
 			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
 
 			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
@@ -530,15 +1098,84 @@ namespace lockfree
 			std::shared_ptr<lockfree::MPSCQueueAny> m_queue;
 		};
 
-		template <typename T> class MPSCQueue
+		template <typename T, typename Capacity = DynamicCapacity, typename Layout = DenseLayout>
+		class MPSCQueue
 		{
+			using queue_type = lockfree::MPSCQueue<T, Capacity, 0, Layout>;
+
 		public:
 			using size_type = std::size_t;
 			using value_type = T;
 
 			MPSCQueue(int max_processes, size_type queue_size)
-				: m_queue(
-					  detail::MakeAndInitialize<lockfree::MPSCQueue<T>>(max_processes, queue_size))
+				: m_queue(detail::MakeAndInitialize<queue_type>(max_processes, queue_size))
+			{
+			}
+
+			auto TryPush(int pid, const value_type& val) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, val);
+			}
+			auto TryPushCombined(int pid, const value_type& val) noexcept -> bool
+			{
+				return m_queue->TryPushCombined(pid, val);
+			}
+
+			auto TryPop() noexcept -> std::optional<value_type> { return m_queue->TryPop(); }
+			auto TryPeek() noexcept -> std::optional<value_type> { return m_queue->TryPeek(); }
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(value_type& outval) noexcept -> bool { return m_queue->TryPop(outval); }
+
+			// Use this variant to avoid need to double copy.
+			auto TryPeek(value_type& outval) noexcept -> bool { return m_queue->TryPeek(outval); }
+
+			auto TryPushN(int pid, const value_type* vals, size_type count) noexcept -> size_type
+			{
+				return m_queue->TryPushN(pid, vals, count);
+			}
+			auto TryPopN(value_type* out, size_type count) noexcept -> size_type
+			{
+				return m_queue->TryPopN(out, count);
+			}
+
+			auto TryPopUnordered() noexcept -> std::optional<value_type>
+			{
+				return m_queue->TryPopUnordered();
+			}
+			auto TryPopUnordered(value_type& outval) noexcept -> bool
+			{
+				return m_queue->TryPopUnordered(outval);
+			}
+
+			auto AcquirePid() noexcept -> std::optional<int> { return m_queue->AcquirePid(); }
+			void ReleasePid(int pid) noexcept { m_queue->ReleasePid(pid); }
+
+			// Pid leased to the calling thread by its first call, and released when it exits.
+			auto ThreadPid() -> std::optional<int>
+			{
+				return detail::ThreadPids<queue_type>::Get(m_queue);
+			}
+
+			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
+
+			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
+
+			[[nodiscard]] auto Size() const noexcept -> size_type { return m_queue->Size(); }
+
+		private:
+			std::shared_ptr<queue_type> m_queue;
+		};
+
+		template <typename T, typename Capacity = DynamicCapacity> class MPSCSeqQueue
+		{
+		public:
+			using size_type = std::size_t;
+			using value_type = T;
+
+			MPSCSeqQueue(int max_processes, size_type queue_size)
+				: m_queue(detail::MakeAndInitialize<lockfree::MPSCSeqQueue<T, Capacity>>(
+					  max_processes, queue_size))
 			{
 			}
 
@@ -561,7 +1198,79 @@ namespace lockfree
 			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
 
 		private:
-			std::shared_ptr<lockfree::MPSCQueue<T>> m_queue;
+			std::shared_ptr<lockfree::MPSCSeqQueue<T, Capacity>> m_queue;
+		};
+	}
+
+	namespace fixed
+	{
+		template <typename T, std::size_t N, int MaxProducers> class MPSCQueue
+		{
+			static_assert(MaxProducers > 0, "Queue must have atleast one producer");
+
+			using queue_type = lockfree::MPSCQueue<T, FixedCapacity<N>, MaxProducers>;
+
+		public:
+			using size_type = typename queue_type::size_type;
+			using value_type = typename queue_type::value_type;
+
+			MPSCQueue() noexcept { queue_type::Initialize(m_storage.data(), MaxProducers, N); }
+
+			~MPSCQueue() { queue_type::Destroy(queue()); }
+
+			MPSCQueue(const MPSCQueue&) = delete;
+			MPSCQueue(MPSCQueue&&) = delete;
+			auto operator=(const MPSCQueue&) -> MPSCQueue& = delete;
+			auto operator=(MPSCQueue&&) -> MPSCQueue& = delete;
+
+			auto TryPush(int pid, const value_type& val) noexcept -> bool
+			{
+				return queue()->TryPush(pid, val);
+			}
+			auto TryPushCombined(int pid, const value_type& val) noexcept -> bool
+			{
+				return queue()->TryPushCombined(pid, val);
+			}
+
+			auto TryPop() noexcept -> std::optional<value_type> { return queue()->TryPop(); }
+			auto TryPeek() noexcept -> std::optional<value_type> { return queue()->TryPeek(); }
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(value_type& outval) noexcept -> bool { return queue()->TryPop(outval); }
+
+			// Use this variant to avoid need to double copy.
+			auto TryPeek(value_type& outval) noexcept -> bool { return queue()->TryPeek(outval); }
+
+			auto TryPushN(int pid, const value_type* vals, size_type count) noexcept -> size_type
+			{
+				return queue()->TryPushN(pid, vals, count);
+			}
+			auto TryPopN(value_type* out, size_type count) noexcept -> size_type
+			{
+				return queue()->TryPopN(out, count);
+			}
+
+			auto TryPopUnordered() noexcept -> std::optional<value_type>
+			{
+				return queue()->TryPopUnordered();
+			}
+			auto TryPopUnordered(value_type& outval) noexcept -> bool
+			{
+				return queue()->TryPopUnordered(outval);
+			}
+
+			auto IsEmpty() noexcept -> bool { return queue()->IsEmpty(); }
+
+			auto IsFull() noexcept -> bool { return queue()->IsFull(); }
+
+		private:
+			auto queue() noexcept -> queue_type*
+			{
+				return std::launder(reinterpret_cast<queue_type*>(m_storage.data()));
+			}
+
+			alignas(queue_type::GetAlignment())
+				std::array<std::byte, queue_type::CalculateSize(MaxProducers, N)> m_storage;
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/align/align_up.hpp>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "lockfree-queue/capacity.h"
+#include "lockfree-queue/detail/defs.h"
+#include "lockfree-queue/spsc.h"
+
+
+namespace lockfree
+{
+	// MPSC queue made of a private `SPSCQueue` lane per producer, of `lane_size` elements each.
+	// Producers push into their own lane with plain release stores, and the consumer polls the
+	// lanes round robin. Like `MPSCPCQueueAny`, producers never contend with each other, but it
+	// needs neither `rseq` nor the cpu id. Elements are ordered only per producer.
+	template <typename T, typename Capacity = DynamicCapacity>
+	class alignas(std::max(detail::CACHELINESIZE, alignof(T))) MPSCLaneQueue
+	{
+		using lane_type = SPSCQueue<T, Capacity>;
+
+	public:
+		using size_type = std::size_t;
+		using value_type = T;
+
+		static constexpr auto GetAlignment() noexcept -> size_type
+		{
+			return std::max(alignof(MPSCLaneQueue), lane_type::GetAlignment());
+		}
+
+		static constexpr auto CalculateSize(int max_processes, size_type lane_size) noexcept
+			-> size_type
+		{
+			// Lanes are placed from `this`, so it must be aligned for them.
+			static_assert(alignof(MPSCLaneQueue) >= lane_type::GetAlignment());
+
+			return boost::alignment::align_up(sizeof(MPSCLaneQueue), lane_type::GetAlignment()) +
+				   lane_type::CalculateSize(lane_size) * max_processes;
+		}
+
+		static auto Initialize(void* queue_ptr, int max_processes, size_type lane_size) noexcept
+			-> MPSCLaneQueue*
+		{
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			return new (static_cast<MPSCLaneQueue*>(queue_ptr))
+				MPSCLaneQueue(max_processes, lane_size);
+		}
+
+		// Destroys the elements left in the queue.
+		static void Destroy(MPSCLaneQueue* ptr) noexcept { std::destroy_at(ptr); }
+
+		MPSCLaneQueue(const MPSCLaneQueue&) = delete;
+		MPSCLaneQueue(MPSCLaneQueue&&) = delete;
+		auto operator=(const MPSCLaneQueue&) -> MPSCLaneQueue& = delete;
+		auto operator=(MPSCLaneQueue&&) -> MPSCLaneQueue& = delete;
+
+		~MPSCLaneQueue()
+		{
+			for (int i = 0; i < m_max_processes; i++)
+				lane_type::Destroy(get_lane(i));
+		}
+
+		template <typename... Args>
+		auto TryEmplace(int pid, Args&&... args) noexcept(
+			std::is_nothrow_constructible_v<value_type, Args&&...>) -> bool
+		{
+			return get_lane(pid)->TryEmplace(std::forward<Args>(args)...);
+		}
+
+		auto TryPush(int pid, const value_type& val) noexcept(
+			std::is_nothrow_copy_constructible_v<value_type>) -> bool
+		{
+			return get_lane(pid)->TryPush(val);
+		}
+		auto TryPush(int pid, value_type&& val) noexcept -> bool
+		{
+			return get_lane(pid)->TryPush(std::move(val));
+		}
+
+		// Pushes upto `count` elements into the lane of `pid`. Returns the number pushed.
+		auto TryPushN(int pid, const value_type* vals, size_type count) noexcept(
+			std::is_nothrow_copy_constructible_v<value_type>) -> size_type
+		{
+			return get_lane(pid)->TryPushN(vals, count);
+		}
+
+		// Consumer stays on a lane for upto `DRAIN_BATCH` pops, while it has elements, so that a
+		// busy lane's head is re-read only once it's drained.
+		auto TryPop(value_type& outval) noexcept(std::is_nothrow_move_assignable_v<value_type>)
+			-> bool
+		{
+			return pop_from_lanes([&](lane_type* lane) { return lane->TryPop(outval); });
+		}
+
+		auto TryPop() noexcept -> std::optional<value_type>
+		{
+			std::optional<value_type> val;
+
+			pop_from_lanes([&](lane_type* lane) {
+				val = lane->TryPop();
+				return val.has_value();
+			});
+
+			return val;
+		}
+
+		// Pops upto `count` elements into `out`, taking whole runs out of every lane visited.
+		// Returns the number of elements popped.
+		auto TryPopN(value_type* out, size_type count) noexcept(
+			std::is_nothrow_move_assignable_v<value_type>) -> size_type
+		{
+			size_type popped = 0;
+
+			for (int i = 0; i <= m_max_processes && popped < count; i++)
+			{
+				const auto lane = (m_cur_lane + i) % m_max_processes;
+
+				if (auto n = get_lane(lane)->TryPopN(out + popped, count - popped); n != 0)
+				{
+					popped += n;
+					m_cur_lane = lane;
+					m_num_drained = DRAIN_BATCH;
+				}
+			}
+
+			return popped;
+		}
+
+		// Checks every lane, so it's only a hint while producers are pushing.
+		[[nodiscard]] auto IsEmpty() const noexcept -> bool
+		{
+			for (int i = 0; i < m_max_processes; i++)
+			{
+				if (!get_lane(i)->IsEmpty())
+					return false;
+			}
+
+			return true;
+		}
+
+		// Check if the lane of `pid` is full.
+		[[nodiscard]] auto IsFull(int pid) const noexcept -> bool
+		{
+			return get_lane(pid)->IsFull();
+		}
+
+	private:
+		static constexpr size_type DRAIN_BATCH = 64;
+
+		MPSCLaneQueue(int max_processes, size_type lane_size) noexcept
+			: m_max_processes(max_processes), m_lane_size(lane_type::CalculateSize(lane_size))
+		{
+			for (int i = 0; i < max_processes; i++)
+				lane_type::Initialize(get_lane(i), lane_size);
+		}
+
+
+		// Tries `pop(lane)` on the current lane, and then on the others round robin.
+		template <typename Pop> auto pop_from_lanes(Pop&& pop) -> bool
+		{
+			if (m_num_drained < DRAIN_BATCH && pop(get_lane(m_cur_lane)))
+			{
+				m_num_drained++;
+				return true;
+			}
+
+			for (int i = 1; i <= m_max_processes; i++)
+			{
+				const auto lane = (m_cur_lane + i) % m_max_processes;
+
+				if (pop(get_lane(lane)))
+				{
+					m_cur_lane = lane;
+					m_num_drained = 1;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		auto get_lane(int pid) noexcept -> lane_type*
+		{
+			auto* p = static_cast<char*>(boost::alignment::align_up(
+				reinterpret_cast<char*>(this) + sizeof(MPSCLaneQueue), lane_type::GetAlignment()));
+			return std::launder(reinterpret_cast<lane_type*>(p + m_lane_size * pid));
+		}
+		[[nodiscard]] auto get_lane(int pid) const noexcept -> const lane_type*
+		{
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+			return const_cast<MPSCLaneQueue*>(this)->get_lane(pid);
+		}
+
+
+		const int m_max_processes;
+		const size_type m_lane_size; // Bytes taken by a lane, including its ring buffer.
+
+		// Owned by the consumer, away from the fields read by the producers.
+		alignas(detail::CACHELINESIZE) int m_cur_lane = 0;
+		size_type m_num_drained = 0; // Pops from `m_cur_lane`, since the consumer moved to it
+	};
+
+	namespace thread
+	{
+		template <typename T, typename Capacity = DynamicCapacity> class MPSCLaneQueue
+		{
+		public:
+			using size_type = std::size_t;
+			using value_type = T;
+
+			MPSCLaneQueue(int max_processes, size_type lane_size)
+				: m_queue(detail::MakeAndInitialize<lockfree::MPSCLaneQueue<T, Capacity>>(
+					  max_processes, lane_size))
+			{
+			}
+
+			template <typename... Args> auto TryEmplace(int pid, Args&&... args) -> bool
+			{
+				return m_queue->TryEmplace(pid, std::forward<Args>(args)...);
+			}
+
+			auto TryPush(int pid, const value_type& val) -> bool
+			{
+				return m_queue->TryPush(pid, val);
+			}
+			auto TryPush(int pid, value_type&& val) noexcept -> bool
+			{
+				return m_queue->TryPush(pid, std::move(val));
+			}
+
+			auto TryPushN(int pid, const value_type* vals, size_type count) -> size_type
+			{
+				return m_queue->TryPushN(pid, vals, count);
+			}
+
+			auto TryPop() noexcept -> std::optional<value_type> { return m_queue->TryPop(); }
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(value_type& outval) -> bool { return m_queue->TryPop(outval); }
+
+			auto TryPopN(value_type* out, size_type count) -> size_type
+			{
+				return m_queue->TryPopN(out, count);
+			}
+
+			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
+
+			auto IsFull(int pid) noexcept -> bool { return m_queue->IsFull(pid); }
+
+		private:
+			std::shared_ptr<lockfree::MPSCLaneQueue<T, Capacity>> m_queue;
+		};
+	}
+}
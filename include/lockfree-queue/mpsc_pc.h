@@ -28,7 +28,33 @@ namespace lockfree
 			-> MPSCPCQueueAny*
 		{
 			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-			return new (static_cast<MPSCPCQueueAny*>(queue_ptr)) MPSCPCQueueAny(per_cpu_queue_size);
+			return new (static_cast<MPSCPCQueueAny*>(queue_ptr)) MPSCPCQueueAny(
+				per_cpu_queue_size, SPSCQueueAny::CalculateSize(per_cpu_queue_size), false);
+		}
+
+		// Every per-cpu ring buffer is mapped twice back to back, so that no element is ever split.
+		// `per_cpu_queue_size` is rounded up to a multiple of the page size.
+		static auto CalculateMirroredLayout(size_type per_cpu_queue_size) noexcept
+			-> detail::MirroredLayout
+		{
+			// Each per-cpu queue sits at the end of its block's header, right before its ring
+			// buffer. The first block's header also holds this queue.
+			const auto page_size = detail::page_size();
+			const auto header_size = boost::alignment::align_up(
+				sizeof(MPSCPCQueueAny) + sizeof(SPSCQueueAny), page_size);
+
+			return { header_size, boost::alignment::align_up(per_cpu_queue_size, page_size),
+				size_type(NUM_CORES), header_size - sizeof(SPSCQueueAny) - sizeof(MPSCPCQueueAny) };
+		}
+
+		static auto InitializeMirrored(void* queue_ptr, size_type per_cpu_queue_size) noexcept
+			-> MPSCPCQueueAny*
+		{
+			const auto layout = CalculateMirroredLayout(per_cpu_queue_size);
+
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			return new (static_cast<MPSCPCQueueAny*>(queue_ptr)) MPSCPCQueueAny(
+				layout.ring_size, layout.header_size + 2 * layout.ring_size, true);
 		}
 
 
@@ -73,7 +99,7 @@ namespace lockfree
 		}
 
 		// `elem` must be allocated to atleast `GetNextElementSize` bytes
-		auto TryPop(void* elem) noexcept -> bool { return TryPop(elem, m_percpu_queue_size); }
+		auto TryPop(void* elem) noexcept -> bool { return TryPop(elem, m_per_cpu_ring_buf_size); }
 
 		// Check if Current cpu's queue is empty.
 		// XXX: Result should only be used as hint, as the current thread might have been be
@@ -99,13 +125,20 @@ namespace lockfree
 		}
 
 
-		explicit MPSCPCQueueAny(size_type per_cpu_ring_buf_size) noexcept
+		MPSCPCQueueAny(
+			size_type per_cpu_ring_buf_size, size_type percpu_queue_size, bool mirrored) noexcept
 			: m_per_cpu_ring_buf_size(per_cpu_ring_buf_size),
-			  m_percpu_queue_size(SPSCQueueAny::CalculateSize(per_cpu_ring_buf_size))
+			  m_per_cpu_ring_buf_mask(PowerOfTwoCapacity::IsValid(per_cpu_ring_buf_size)
+					  ? per_cpu_ring_buf_size - 1
+					  : 0),
+			  m_per_cpu_ring_buf_span(mirrored ? 2 * per_cpu_ring_buf_size : per_cpu_ring_buf_size),
+			  m_percpu_queue_size(percpu_queue_size)
 		{
+			// `TryPush` writes elements in the default framing.
 			for (int i = 0; i < NUM_CORES; i++)
 			{
-				SPSCQueueAny::Initialize(&get_queue(this, i), per_cpu_ring_buf_size);
+				// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+				new (&get_queue(this, i)) SPSCQueueAny(per_cpu_ring_buf_size, Framing{}, mirrored);
 			}
 		}
 
@@ -123,6 +156,8 @@ namespace lockfree
 		static inline const int NUM_CORES = int(std::thread::hardware_concurrency());
 
 		const size_type m_per_cpu_ring_buf_size;
+		const size_type m_per_cpu_ring_buf_mask; // 0, if size is not a power of two
+		const size_type m_per_cpu_ring_buf_span; // Twice the size, if ring buffer is mirrored
 		const size_type m_percpu_queue_size;
 		int m_next_poll_cpu = 0;
 		std::optional<SPSCQueueAny::ElemInfo> m_current_fetch_elem = {};
@@ -137,8 +172,10 @@ namespace lockfree
 		public:
 			using size_type = std::size_t;
 
-			explicit MPSCPCQueueAny(size_type queue_size)
-				: m_queue(detail::MakeAndInitialize<lockfree::MPSCPCQueueAny>(queue_size))
+			explicit MPSCPCQueueAny(size_type queue_size, bool mirrored = false)
+				: m_queue(mirrored
+						  ? detail::MakeAndInitializeMirrored<lockfree::MPSCPCQueueAny>(queue_size)
+						  : detail::MakeAndInitialize<lockfree::MPSCPCQueueAny>(queue_size))
 			{
 			}
 
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <boost/align/align_up.hpp>
+#include <boost/align/aligned_alloc.hpp>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "lockfree-queue/capacity.h"
+#include "lockfree-queue/detail/defs.h"
+#include "lockfree-queue/detail/scopeexit.h"
+#include "lockfree-queue/mpsc.h"
+
+
+namespace lockfree
+{
+	// MPSC queue without a capacity. Elements are stored in a chain of `MPSCQueue` segments, of
+	// `segment_size` elements each. When the head segment fills, producers link the next one.
+	// Consumer recycles the drained segments, so that no allocation is done once the chain is long
+	// enough to absorb the bursts.
+	template <typename T, typename Capacity = DynamicCapacity> class MPSCUnboundedQueue
+	{
+		using segment_queue = MPSCQueue<T, Capacity>;
+
+	public:
+		using size_type = std::size_t;
+		using value_type = T;
+
+		MPSCUnboundedQueue(int max_processes, size_type segment_size)
+			: m_max_processes(max_processes), m_segment_size(segment_size),
+			  m_hazards(std::make_unique<Hazard[]>(max_processes))
+		{
+			m_tail_seg = allocate_segment();
+			m_head_seg.store(m_tail_seg);
+		}
+
+		~MPSCUnboundedQueue()
+		{
+			for (auto* seg = m_tail_seg; seg != nullptr;)
+				free_segment(std::exchange(seg, detail::load_acquire(seg->next)));
+			for (auto* seg = m_free; seg != nullptr;)
+				free_segment(std::exchange(seg, seg->free_next));
+			if (auto* seg = m_spare.load(); seg != nullptr)
+				free_segment(seg);
+		}
+
+		MPSCUnboundedQueue(const MPSCUnboundedQueue&) = delete;
+		MPSCUnboundedQueue(MPSCUnboundedQueue&&) = delete;
+		auto operator=(const MPSCUnboundedQueue&) -> MPSCUnboundedQueue& = delete;
+		auto operator=(MPSCUnboundedQueue&&) -> MPSCUnboundedQueue& = delete;
+
+		// Throws `std::bad_alloc`, if a new segment is needed and cannot be allocated.
+		void Push(int pid, const value_type& val)
+		{
+			auto& hazard = m_hazards[pid].seg;
+			SCOPE_EXIT([&] { detail::store_release(hazard, static_cast<Segment*>(nullptr)); });
+
+			auto* seg = detail::load_acquire(m_head_seg);
+
+			for (;;)
+			{
+				// Sequentially consistent, so that either the consumer sees the hazard or we see
+				// the head moved past `seg`, before it is recycled.
+				hazard.store(seg);
+				if (auto* head = m_head_seg.load(); head != seg)
+				{
+					seg = head;
+					continue;
+				}
+
+				if (seg->queue()->TryPush(pid, val))
+					return;
+
+				seg = advance_head(seg);
+			}
+		}
+
+		auto TryPop(value_type& outval) noexcept -> bool
+		{
+			for (;;)
+			{
+				auto* seg = m_tail_seg;
+
+				if (seg->queue()->TryPop(outval))
+					return true;
+
+				if (!is_retired(seg))
+				{
+					refill_spare();
+					return false;
+				}
+
+				// No one pushes into `seg` anymore, so whatever is left is final.
+				if (seg->queue()->TryPop(outval))
+					return true;
+
+				m_tail_seg = detail::load_acquire(seg->next);
+				recycle_segment(seg);
+			}
+		}
+
+		auto TryPop() noexcept -> std::optional<value_type>
+		{
+			value_type val;
+			if (TryPop(val))
+				return val;
+
+			return {};
+		}
+
+		// Must be called only by the consumer.
+		auto IsEmpty() noexcept -> bool
+		{
+			auto* head = m_head_seg.load();
+
+			for (auto* seg = m_tail_seg;; seg = detail::load_acquire(seg->next))
+			{
+				if (!seg->queue()->IsEmpty())
+					return false;
+				if (seg == head)
+					return true;
+			}
+		}
+
+		// Number of segments allocated so far, including the first one.
+		[[nodiscard]] auto SegmentAllocations() const noexcept -> size_type
+		{
+			return detail::load_relaxed(m_num_allocated);
+		}
+
+		// Most memory held by the segments at once, in bytes.
+		[[nodiscard]] auto MemoryHighWater() const noexcept -> size_type
+		{
+			return detail::load_relaxed(m_max_live) * segment_alloc_size();
+		}
+
+	private:
+		// Upto this many drained segments are kept for reuse, besides the spare one.
+		static constexpr size_type MAX_FREE_SEGMENTS = 4;
+
+		struct alignas(detail::CACHELINESIZE) Segment
+		{
+			std::atomic<Segment*> next = nullptr;
+			Segment* free_next = nullptr; // Owned by the consumer.
+
+			auto queue() noexcept -> segment_queue*
+			{
+				auto* p = reinterpret_cast<char*>(this) + sizeof(Segment);
+				return std::launder(reinterpret_cast<segment_queue*>(
+					boost::alignment::align_up(p, segment_queue::GetAlignment())));
+			}
+		};
+
+		// Segment a producer is pushing into. Consumer doesn't recycle it, until it is cleared.
+		struct alignas(detail::CACHELINESIZE) Hazard
+		{
+			std::atomic<Segment*> seg = nullptr;
+		};
+
+
+		// Link a segment after the full `seg`, if no one did yet, and move the head to it.
+		auto advance_head(Segment* seg) -> Segment*
+		{
+			auto* next = detail::load_acquire(seg->next);
+
+			if (next == nullptr)
+			{
+				auto* fresh = m_spare.exchange(nullptr);
+				if (fresh == nullptr)
+					fresh = allocate_segment();
+
+				if (seg->next.compare_exchange_strong(next, fresh))
+				{
+					next = fresh;
+				}
+				else if (Segment* empty = nullptr; !m_spare.compare_exchange_strong(empty, fresh))
+				{
+					free_segment(fresh);
+				}
+			}
+
+			m_head_seg.compare_exchange_strong(seg, next);
+			return next;
+		}
+
+		// `seg` is behind the head and no producer is still inside it.
+		auto is_retired(Segment* seg) const noexcept -> bool
+		{
+			if (m_head_seg.load() == seg)
+				return false;
+
+			for (int i = 0; i < m_max_processes; i++)
+			{
+				if (m_hazards[i].seg.load() == seg)
+					return false;
+			}
+
+			return true;
+		}
+
+		void recycle_segment(Segment* seg) noexcept
+		{
+			segment_queue::Destroy(seg->queue());
+			segment_queue::Initialize(seg->queue(), m_max_processes, m_segment_size);
+			seg->next.store(nullptr, std::memory_order_relaxed);
+
+			if (m_num_free == MAX_FREE_SEGMENTS)
+			{
+				free_segment(seg);
+			}
+			else
+			{
+				seg->free_next = std::exchange(m_free, seg);
+				m_num_free++;
+			}
+
+			refill_spare();
+		}
+
+		// Hand a free segment to the producers, unless they have one already.
+		void refill_spare() noexcept
+		{
+			if (m_free == nullptr || detail::load_relaxed(m_spare) != nullptr)
+				return;
+
+			auto* seg = m_free;
+			if (Segment* empty = nullptr; m_spare.compare_exchange_strong(empty, seg))
+			{
+				m_free = seg->free_next;
+				m_num_free--;
+			}
+		}
+
+		[[nodiscard]] auto segment_alloc_size() const noexcept -> size_type
+		{
+			return boost::alignment::align_up(sizeof(Segment), segment_queue::GetAlignment()) +
+				   segment_queue::CalculateSize(m_max_processes, m_segment_size);
+		}
+
+		auto allocate_segment() -> Segment*
+		{
+			constexpr auto alignment = std::max(alignof(Segment), segment_queue::GetAlignment());
+			auto* mem = boost::alignment::aligned_alloc(alignment, segment_alloc_size());
+
+			if (mem == nullptr)
+				throw std::bad_alloc();
+
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			auto* seg = new (mem) Segment{};
+			segment_queue::Initialize(seg->queue(), m_max_processes, m_segment_size);
+
+			m_num_allocated.fetch_add(1, std::memory_order_relaxed);
+
+			const auto live = m_num_live.fetch_add(1, std::memory_order_relaxed) + 1;
+			auto max_live = detail::load_relaxed(m_max_live);
+			while (max_live < live && !m_max_live.compare_exchange_weak(max_live, live))
+				;
+
+			return seg;
+		}
+
+		void free_segment(Segment* seg) noexcept
+		{
+			segment_queue::Destroy(seg->queue());
+			std::destroy_at(seg);
+			boost::alignment::aligned_free(seg);
+
+			m_num_live.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+
+		const int m_max_processes;
+		const size_type m_segment_size;
+		const std::unique_ptr<Hazard[]> m_hazards;
+
+		alignas(detail::CACHELINESIZE) std::atomic<Segment*> m_head_seg = nullptr;
+		alignas(detail::CACHELINESIZE) std::atomic<Segment*> m_spare = nullptr;
+
+		// Owned by the consumer.
+		alignas(detail::CACHELINESIZE) Segment* m_tail_seg = nullptr;
+		Segment* m_free = nullptr;
+		size_type m_num_free = 0;
+
+		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_num_allocated = 0;
+		std::atomic<size_type> m_num_live = 0;
+		std::atomic<size_type> m_max_live = 0;
+	};
+
+	namespace thread
+	{
+		template <typename T, typename Capacity = DynamicCapacity> class MPSCUnboundedQueue
+		{
+		public:
+			using size_type = std::size_t;
+			using value_type = T;
+
+			MPSCUnboundedQueue(int max_processes, size_type segment_size)
+				: m_queue(std::make_shared<lockfree::MPSCUnboundedQueue<T, Capacity>>(
+					  max_processes, segment_size))
+			{
+			}
+
+			void Push(int pid, const value_type& val) { m_queue->Push(pid, val); }
+
+			auto TryPop() noexcept -> std::optional<value_type> { return m_queue->TryPop(); }
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(value_type& outval) noexcept -> bool { return m_queue->TryPop(outval); }
+
+			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
+
+			[[nodiscard]] auto SegmentAllocations() const noexcept -> size_type
+			{
+				return m_queue->SegmentAllocations();
+			}
+			[[nodiscard]] auto MemoryHighWater() const noexcept -> size_type
+			{
+				return m_queue->MemoryHighWater();
+			}
+
+		private:
+			std::shared_ptr<lockfree::MPSCUnboundedQueue<T, Capacity>> m_queue;
+		};
+	}
+}
@@ -1,16 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <boost/align/align_up.hpp>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <new>
 #include <optional>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 
+#include "lockfree-queue/capacity.h"
 #include "lockfree-queue/detail/defs.h"
 #include "lockfree-queue/detail/ringbuf.h"
+#include "lockfree-queue/framing.h"
 
 
 namespace lockfree
@@ -19,36 +28,110 @@ namespace lockfree
 	{
 	public:
 		using size_type = std::size_t;
+		using WriteRegion = detail::RingBufRegion<char>;
+		using ReadRegion = detail::RingBufRegion<const char>;
 
-		static auto CalculateSize(size_type queue_size) noexcept -> size_type
+		static auto CalculateSize(size_type queue_size, const Framing& /*framing*/ = {},
+			size_type /*publish_batch*/ = 1) noexcept -> size_type
 		{
 			return boost::alignment::align_up(
 				sizeof(SPSCQueueAny) + queue_size, alignof(SPSCQueueAny));
 		}
 
-		static auto Initialize(void* queue_ptr, size_type queue_size) noexcept -> SPSCQueueAny*
+		// `queue_size` must be a multiple of `framing.PayloadAlignment()`.
+		// When `publish_batch` > 1, producer and consumer publish their positions only once every
+		// `publish_batch` operations, or on their next operation after the other side found the
+		// queue empty or full. Staleness is bounded in operations, not in time: nothing is
+		// published between the calls, so upto `publish_batch - 1` pushes stay invisible to the
+		// consumer, until the producer's next push or `Flush`. Likewise for the pops and the
+		// producer, until `FlushPop`.
+		static auto Initialize(void* queue_ptr, size_type queue_size, const Framing& framing = {},
+			size_type publish_batch = 1) noexcept -> SPSCQueueAny*
 		{
 			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-			return new (static_cast<SPSCQueueAny*>(queue_ptr)) SPSCQueueAny(queue_size);
+			return new (static_cast<SPSCQueueAny*>(queue_ptr))
+				SPSCQueueAny(queue_size, framing, false, publish_batch);
+		}
+
+		// Ring buffer is mapped twice back to back, so that no element is ever split.
+		// `queue_size` is rounded up to a multiple of the page size.
+		static auto CalculateMirroredLayout(size_type queue_size, const Framing& /*framing*/ = {},
+			size_type /*publish_batch*/ = 1) noexcept -> detail::MirroredLayout
+		{
+			const auto page_size = detail::page_size();
+			const auto header_size = boost::alignment::align_up(sizeof(SPSCQueueAny), page_size);
+
+			return { header_size, boost::alignment::align_up(queue_size, page_size), 1,
+				header_size - sizeof(SPSCQueueAny) };
+		}
+
+		static auto InitializeMirrored(void* queue_ptr, size_type queue_size,
+			const Framing& framing = {}, size_type publish_batch = 1) noexcept -> SPSCQueueAny*
+		{
+			const auto layout = CalculateMirroredLayout(queue_size);
+
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			return new (static_cast<SPSCQueueAny*>(queue_ptr))
+				SPSCQueueAny(layout.ring_size, framing, true, publish_batch);
 		}
 
 		auto TryPush(const void* elem, size_type elemsize) noexcept -> bool
 		{
-			auto head = detail::load_acquire(m_head);
-			auto tail = detail::load_acquire(m_tail);
+			assert(m_reserved_size == INVALID_SIZE);
+			auto head = m_local_head;
+			const auto newhead = m_framing.ElemEnd(head, elemsize);
 
-			if (!is_full(elemsize + sizeof(size_type), head, tail))
+			if (!is_full_cached(newhead - head, head))
 			{
 				detail::copy_elem_into_ringbuf(
-					get_queue_data(), m_queue_size, head, elem, elemsize);
+					get_queue_data(), m_capacity, m_mirrored, m_framing, head, elem, elemsize);
 
-				detail::store_release(m_head, head + sizeof(size_type) + elemsize);
+				publish_head(newhead);
 				return true;
 			}
 
 			return false;
 		}
 
+		// Reserve `elemsize` bytes inside the queue, for the element to be written in place.
+		// Nothing is visible to the consumer until `Commit`. Only one reservation can be pending.
+		auto Reserve(size_type elemsize) noexcept -> std::optional<WriteRegion>
+		{
+			assert(m_reserved_size == INVALID_SIZE);
+			auto head = m_local_head;
+
+			if (!is_full_cached(m_framing.ElemEnd(head, elemsize) - head, head))
+			{
+				m_reserved_size = elemsize;
+				return detail::get_ringbuf_region(get_queue_data(), m_capacity, m_mirrored,
+					m_framing.PayloadPos(head), elemsize);
+			}
+
+			return {};
+		}
+
+		// Publish the first `elemsize` bytes of the pending reservation as an element.
+		void Commit(size_type elemsize) noexcept
+		{
+			assert(m_reserved_size != INVALID_SIZE && elemsize <= m_reserved_size);
+			auto head = m_local_head;
+			char header[sizeof(std::uint64_t)];
+
+			m_framing.StoreHeader(header, elemsize);
+			detail::copy_into_ringbuf(get_queue_data(), m_capacity, m_mirrored,
+				m_framing.HeaderPos(head), header, m_framing.HeaderSize());
+			m_reserved_size = INVALID_SIZE;
+
+			publish_head(m_framing.ElemEnd(head, elemsize));
+		}
+
+		// Drop the pending reservation, without publishing anything.
+		void Abort() noexcept
+		{
+			assert(m_reserved_size != INVALID_SIZE);
+			m_reserved_size = INVALID_SIZE;
+		}
+
 		auto GetNextElementSize() noexcept -> std::optional<size_type>
 		{
 			if (auto elem = GetNextElement())
@@ -59,57 +142,87 @@ namespace lockfree
 		// `elem` must be allocated to atleast `min(req_elemsize, GetNextElementSize())` bytes
 		auto TryPop(void* elem, size_type req_elemsize) noexcept -> bool
 		{
-			auto head = detail::load_acquire(m_head);
-			auto tail = detail::load_acquire(m_tail);
+			auto tail = m_local_tail;
 
-			assert(tail <= head);
-			if (tail < head)
+			if (!is_empty_cached(tail))
 			{
-				size_type elemsize;
+				auto elemsize = detail::read_elem_size(
+					get_queue_data(), m_capacity, m_mirrored, m_framing, tail);
 
-				detail::copy_out_of_ringbuf(
-					get_queue_data(), m_queue_size, tail, &elemsize, sizeof(size_type));
-				Pop(tail + sizeof(size_type), elemsize, elem, req_elemsize);
+				Pop(m_framing.PayloadPos(tail), elemsize, elem, req_elemsize);
 				return true;
 			}
 
 			return false;
 		}
 
-		auto TryPop(void* elem) noexcept -> bool { return TryPop(elem, m_queue_size); }
+		auto TryPop(void* elem) noexcept -> bool { return TryPop(elem, m_capacity.Size()); }
 
 		// `elem` must be allocated to atleast `min(req_elemsize, GetNextElementSize())` bytes
 		auto TryPeek(void* elem, size_type req_elemsize) noexcept -> bool
 		{
-			auto head = detail::load_acquire(m_head);
-			auto tail = detail::load_acquire(m_tail);
+			auto tail = m_local_tail;
 
-			assert(tail <= head);
-			if (tail < head)
+			if (!is_empty_cached(tail))
 			{
-				size_type elemsize;
+				auto elemsize = detail::read_elem_size(
+					get_queue_data(), m_capacity, m_mirrored, m_framing, tail);
 
-				detail::copy_out_of_ringbuf(
-					get_queue_data(), m_queue_size, tail, &elemsize, sizeof(size_type));
-				detail::copy_out_of_ringbuf(
-					get_queue_data(), m_queue_size, tail, elem, std::min(req_elemsize, elemsize));
+				detail::copy_out_of_ringbuf(get_queue_data(), m_capacity, m_mirrored,
+					m_framing.PayloadPos(tail), elem, std::min(req_elemsize, elemsize));
 				return true;
 			}
 
 			return false;
 		}
 
-		auto TryPeek(void* elem) noexcept -> bool { return TryPeek(elem, m_queue_size); }
+		auto TryPeek(void* elem) noexcept -> bool { return TryPeek(elem, m_capacity.Size()); }
+
+		// Get a read-only view of the front element inside the queue, without copying it out.
+		// The view stays valid until `Consume`.
+		auto TryRead() noexcept -> std::optional<ReadRegion>
+		{
+			if (auto elem = GetNextElement())
+			{
+				m_read_size = elem->size;
+				return detail::get_ringbuf_region(static_cast<const char*>(get_queue_data()),
+					m_capacity, m_mirrored, elem->pos, elem->size);
+			}
+
+			return {};
+		}
+
+		// Pop the element viewed by the last `TryRead`.
+		void Consume() noexcept
+		{
+			assert(m_read_size != INVALID_SIZE);
+			auto tail = m_local_tail;
+
+			publish_tail(m_framing.ElemEnd(tail, m_read_size));
+			m_read_size = INVALID_SIZE;
+		}
+
+		// Publish the pushes deferred so far. With deferred publication, producer must call this
+		// once it stops pushing, or the consumer never sees the last elements, however long it
+		// waits.
+		void Flush() noexcept { detail::store_release(m_head, m_local_head); }
 
+		// Publish the pops deferred so far. Consumer must call this once it stops popping, for the
+		// producer to reuse the last slots.
+		void FlushPop() noexcept { detail::store_release(m_tail, m_local_tail); }
 
+		// With deferred publication, only published pushes and pops are accounted.
 		[[nodiscard]] auto IsFull() const noexcept -> bool
 		{
-			return is_full(sizeof(size_type) + 1);
+			auto head = detail::load_acquire(m_head);
+			return is_full(m_framing.ElemEnd(head, 1) - head, head, detail::load_acquire(m_tail));
 		}
 
 		[[nodiscard]] auto IsEmpty() const noexcept -> bool { return is_empty(); }
 
 	private:
+		static constexpr auto INVALID_SIZE = std::numeric_limits<size_type>::max();
+
 		struct ElemInfo
 		{
 			size_type size;
@@ -117,23 +230,26 @@ namespace lockfree
 			int cpu = {};
 		};
 
-		explicit SPSCQueueAny(size_type queue_size) noexcept : m_queue_size(queue_size) {}
+		explicit SPSCQueueAny(size_type queue_size, const Framing& framing = {},
+			bool mirrored = false, size_type publish_batch = 1) noexcept
+			: m_capacity(queue_size), m_framing(framing), m_mirrored(mirrored),
+			  m_publish_batch(publish_batch)
+		{
+			assert(queue_size % framing.PayloadAlignment() == 0);
+			assert(publish_batch != 0);
+		}
 
 		friend class MPSCPCQueueAny;
 
 		auto GetNextElement() noexcept -> std::optional<ElemInfo>
 		{
-			auto head = detail::load_acquire(m_head);
-			auto tail = detail::load_acquire(m_tail);
+			auto tail = m_local_tail;
 
-			assert(tail <= head);
-			if (tail < head)
+			if (!is_empty_cached(tail))
 			{
-				size_type elemsize;
-
-				detail::copy_out_of_ringbuf(
-					get_queue_data(), m_queue_size, tail, &elemsize, sizeof(size_type));
-				return ElemInfo{ elemsize, tail + sizeof(size_type) };
+				return ElemInfo{ detail::read_elem_size(
+									 get_queue_data(), m_capacity, m_mirrored, m_framing, tail),
+					m_framing.PayloadPos(tail) };
 			}
 
 			return {};
@@ -141,19 +257,48 @@ namespace lockfree
 
 		void Pop(size_type tail, size_type elemsize, void* elem, size_type req_elemsize) noexcept
 		{
-			detail::copy_out_of_ringbuf(
-				get_queue_data(), m_queue_size, tail, elem, std::min(req_elemsize, elemsize));
-			detail::store_release(m_tail, tail + elemsize);
+			detail::copy_out_of_ringbuf(get_queue_data(), m_capacity, m_mirrored, tail, elem,
+				std::min(req_elemsize, elemsize));
+			publish_tail(tail + elemsize);
 		}
 
-		[[nodiscard]] auto is_full(size_type elemsize) const noexcept -> bool
-		{
-			return is_full(elemsize, detail::load_acquire(m_head), detail::load_acquire(m_tail));
-		}
 		[[nodiscard]] auto is_full(
 			size_type elemsize, size_type head, size_type tail) const noexcept -> bool
 		{
-			return head + elemsize - 1 - tail >= m_queue_size;
+			return head + elemsize - 1 - tail >= m_capacity.Size();
+		}
+
+		// Producer only. `m_tail` is re-read only when the cached copy says the queue is full.
+		auto is_full_cached(size_type elemsize, size_type head) noexcept -> bool
+		{
+			if (is_full(elemsize, head, m_cached_tail))
+			{
+				m_cached_tail = detail::load_acquire(m_tail);
+				if (is_full(elemsize, head, m_cached_tail))
+				{
+					on_full();
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		// Consumer only. `m_head` is re-read only when the cached copy says the queue is empty.
+		auto is_empty_cached(size_type tail) noexcept -> bool
+		{
+			assert(tail <= m_cached_head);
+			if (tail == m_cached_head)
+			{
+				m_cached_head = detail::load_acquire(m_head);
+				if (tail == m_cached_head)
+				{
+					on_empty();
+					return true;
+				}
+			}
+
+			return false;
 		}
 
 		[[nodiscard]] auto is_empty() const noexcept -> bool
@@ -165,6 +310,70 @@ namespace lockfree
 			return tail == head;
 		}
 
+		// Producer only. With deferred publication, `head` is published only when `m_publish_batch`
+		// pushes are pending, or when the consumer is waiting on an empty queue.
+		void publish_head(size_type head) noexcept
+		{
+			m_local_head = head;
+
+			if (m_publish_batch != 1)
+			{
+				set_waiting(m_producer_waiting, false);
+				if (head - detail::load_relaxed(m_head) < m_publish_batch &&
+					!detail::load_relaxed(m_consumer_waiting))
+				{
+					return;
+				}
+			}
+
+			detail::store_release(m_head, head);
+		}
+
+		// Consumer only. Counterpart of `publish_head`.
+		void publish_tail(size_type tail) noexcept
+		{
+			m_local_tail = tail;
+
+			if (m_publish_batch != 1)
+			{
+				set_waiting(m_consumer_waiting, false);
+				if (tail - detail::load_relaxed(m_tail) < m_publish_batch &&
+					!detail::load_relaxed(m_producer_waiting))
+				{
+					return;
+				}
+			}
+
+			detail::store_release(m_tail, tail);
+		}
+
+		// Producer found the queue full. Publish the pending pushes, so that the consumer can pop
+		// them, and ask the consumer to publish its pops right away.
+		void on_full() noexcept
+		{
+			if (m_publish_batch != 1)
+			{
+				Flush();
+				set_waiting(m_producer_waiting, true);
+			}
+		}
+
+		// Consumer found the queue empty. Counterpart of `on_full`.
+		void on_empty() noexcept
+		{
+			if (m_publish_batch != 1)
+			{
+				FlushPop();
+				set_waiting(m_consumer_waiting, true);
+			}
+		}
+
+		static void set_waiting(std::atomic<bool>& waiting, bool val) noexcept
+		{
+			if (detail::load_relaxed(waiting) != val)
+				waiting.store(val, std::memory_order_relaxed);
+		}
+
 
 		auto get_queue_data() noexcept -> char*
 		{
@@ -177,112 +386,269 @@ namespace lockfree
 			return const_cast<SPSCQueueAny*>(this)->get_queue_data();
 		}
 
-		const size_type m_queue_size;
+		const DynamicCapacity m_capacity;
+		const Framing m_framing;
+		const bool m_mirrored;
+		const size_type m_publish_batch;
 
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
+		std::atomic<bool> m_producer_waiting = false; // Producer found the queue full
+		alignas(detail::CACHELINESIZE) size_type m_cached_tail = 0; // Producer's copy of `m_tail`
+		size_type m_local_head = 0; // `m_head`, including unpublished pushes
+		size_type m_reserved_size = INVALID_SIZE;
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
+		std::atomic<bool> m_consumer_waiting = false; // Consumer found the queue empty
+		alignas(detail::CACHELINESIZE) size_type m_cached_head = 0; // Consumer's copy of `m_head`
+		size_type m_local_tail = 0; // `m_tail`, including unpublished pops
+		size_type m_read_size = INVALID_SIZE;
 	};
 
 	static_assert(std::is_trivially_copyable_v<SPSCQueueAny>);
 
-	template <typename T> class SPSCQueue
+	// Elements are constructed in place inside the ring buffer and destroyed, when popped or when
+	// the queue is destroyed.
+	template <typename T, typename Capacity = DynamicCapacity> class SPSCQueue
 	{
-		static_assert(std::is_trivial_v<T>, "Type must be trivial to be store inside queue");
+		static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_destructible_v<T>,
+			"Type must be nothrow move constructible and destructible to be store inside queue");
 
 	public:
 		using size_type = std::size_t;
 		using value_type = T;
 
-		static auto GetAlignment() noexcept -> size_type
+		static constexpr auto GetAlignment() noexcept -> size_type
 		{
 			return std::max(alignof(SPSCQueue), alignof(value_type));
 		}
 
-		static auto CalculateSize(size_type elemcount) noexcept -> size_type
+		static constexpr auto CalculateSize(
+			size_type elemcount, size_type /*publish_batch*/ = 1) noexcept -> size_type
 		{
 			return boost::alignment::align_up(
 				sizeof(SPSCQueue) + elemcount * sizeof(value_type), GetAlignment());
 		}
 
-		static auto Initialize(void* queue_ptr, size_type elemcount) noexcept -> SPSCQueue*
+		// When `publish_batch` > 1, producer and consumer publish their positions only once every
+		// `publish_batch` operations, or on their next operation after the other side found the
+		// queue empty or full. Staleness is bounded in operations, not in time: nothing is
+		// published between the calls, so upto `publish_batch - 1` elements stay invisible to the
+		// consumer, until the producer's next push or `Flush`. Likewise for the popped slots and
+		// the producer, until `FlushPop`.
+		static auto Initialize(void* queue_ptr, size_type elemcount,
+			size_type publish_batch = 1) noexcept -> SPSCQueue*
 		{
 			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-			return new (static_cast<SPSCQueue*>(queue_ptr)) SPSCQueue(elemcount);
+			return new (static_cast<SPSCQueue*>(queue_ptr)) SPSCQueue(elemcount, publish_batch);
 		}
 
-		auto TryPush(const value_type& elem) noexcept -> bool
+		// Destroys the elements left in the queue.
+		static void Destroy(SPSCQueue* ptr) noexcept { std::destroy_at(ptr); }
+
+		SPSCQueue(const SPSCQueue&) = delete;
+		SPSCQueue(SPSCQueue&&) = delete;
+		auto operator=(const SPSCQueue&) -> SPSCQueue& = delete;
+		auto operator=(SPSCQueue&&) -> SPSCQueue& = delete;
+
+		~SPSCQueue()
 		{
-			auto head = detail::load_acquire(m_head);
-			auto tail = detail::load_acquire(m_tail);
+			if constexpr (!std::is_trivially_destructible_v<value_type>)
+			{
+				auto* data = get_queue_data();
+
+				for (auto tail = m_local_tail; tail != m_local_head; tail++)
+					std::destroy_at(&data[m_capacity.Wrap(tail)]);
+			}
+		}
+
+		// Construct an element in place, from `args`.
+		template <typename... Args>
+		auto TryEmplace(Args&&... args) noexcept(
+			std::is_nothrow_constructible_v<value_type, Args&&...>) -> bool
+		{
+			auto head = m_local_head;
 
-			if (!is_full(head, tail))
+			if (free_count_cached(head, 1) != 0)
 			{
-				get_queue_data()[head] = elem;
-				detail::store_release(m_head, head + 1);
+				new (&get_queue_data()[m_capacity.Wrap(head)])
+					value_type(std::forward<Args>(args)...);
+				publish_head(head + 1);
 				return true;
 			}
 
 			return false;
 		}
 
-		// To avoid double copy
-		auto TryPop(value_type& elem) noexcept -> bool
+		auto TryPush(const value_type& elem) noexcept(
+			std::is_nothrow_copy_constructible_v<value_type>) -> bool
 		{
-			auto head = detail::load_acquire(m_head);
-			auto tail = detail::load_acquire(m_tail);
+			return TryEmplace(elem);
+		}
 
-			assert(tail <= head);
-			if (tail < head)
+		auto TryPush(value_type&& elem) noexcept -> bool { return TryEmplace(std::move(elem)); }
+
+		// Push as many elements of [first, last) as fit, publishing them with a single store.
+		// Returns the number of elements pushed.
+		template <typename ForwardIt>
+		auto TryPushN(ForwardIt first, ForwardIt last) noexcept(
+			std::is_nothrow_copy_constructible_v<value_type>) -> size_type
+		{
+			auto head = m_local_head;
+			auto count = static_cast<size_type>(std::distance(first, last));
+
+			count = std::min(count, free_count_cached(head, count));
+			if (count == 0)
+				return 0;
+
+			const auto pos = m_capacity.Wrap(head);
+			const auto len = std::min(count, m_capacity.Size() - pos);
+			auto* data = get_queue_data();
+			auto mid = std::next(first, len);
+
+			auto* end = std::uninitialized_copy(first, mid, data + pos);
+			if constexpr (std::is_nothrow_copy_constructible_v<value_type>)
+			{
+				std::uninitialized_copy(mid, std::next(mid, count - len), data);
+			}
+			else
+			{
+				try
+				{
+					std::uninitialized_copy(mid, std::next(mid, count - len), data);
+				}
+				catch (...)
+				{
+					// Nothing is published, when a copy fails.
+					std::destroy(data + pos, end);
+					throw;
+				}
+			}
+
+			publish_head(head + count);
+			return count;
+		}
+
+		auto TryPushN(const value_type* elems, size_type count) noexcept(
+			std::is_nothrow_copy_constructible_v<value_type>) -> size_type
+		{
+			return TryPushN(elems, elems + count);
+		}
+
+		// To avoid double copy. Element is moved out.
+		auto TryPop(value_type& elem) noexcept(std::is_nothrow_move_assignable_v<value_type>)
+			-> bool
+		{
+			auto tail = m_local_tail;
+
+			if (used_count_cached(tail, 1) != 0)
 			{
-				elem = get_queue_data()[tail];
-				detail::store_release(m_tail, tail + 1);
+				auto& slot = get_queue_data()[m_capacity.Wrap(tail)];
+
+				elem = std::move(slot);
+				std::destroy_at(&slot);
+				publish_tail(tail + 1);
 				return true;
 			}
 
 			return false;
 		}
 
+		// Pop upto `count` elements into `out`, releasing their slots with a single store.
+		// Returns the number of elements popped.
+		template <typename OutputIt>
+		auto TryPopN(OutputIt out, size_type count) noexcept(
+			IS_NOTHROW_OUTPUT<OutputIt>) -> size_type
+		{
+			auto tail = m_local_tail;
+
+			count = std::min(count, used_count_cached(tail, count));
+			if (count == 0)
+				return 0;
+
+			const auto pos = m_capacity.Wrap(tail);
+			const auto len = std::min(count, m_capacity.Size() - pos);
+			auto* data = get_queue_data();
+
+			out = std::move(data + pos, data + pos + len, out);
+			std::move(data, data + (count - len), out);
+			std::destroy_n(data + pos, len);
+			std::destroy_n(data, count - len);
+
+			publish_tail(tail + count);
+			return count;
+		}
+
 		auto TryPop() noexcept -> std::optional<value_type>
 		{
-			value_type elem;
-			if (TryPop(elem))
+			auto tail = m_local_tail;
+
+			if (used_count_cached(tail, 1) != 0)
+			{
+				auto& slot = get_queue_data()[m_capacity.Wrap(tail)];
+				std::optional<value_type> elem{ std::move(slot) };
+
+				std::destroy_at(&slot);
+				publish_tail(tail + 1);
 				return elem;
+			}
+
 			return {};
 		}
 
 		// To avoid double copy
-		auto TryPeek(value_type& elem) noexcept -> bool
+		auto TryPeek(value_type& elem) noexcept(std::is_nothrow_copy_assignable_v<value_type>)
+			-> bool
 		{
-			auto head = detail::load_acquire(m_head);
-			auto tail = detail::load_acquire(m_tail);
+			auto tail = m_local_tail;
 
-			assert(tail <= head);
-			if (tail < head)
+			if (used_count_cached(tail, 1) != 0)
 			{
-				elem = get_queue_data()[tail];
+				elem = get_queue_data()[m_capacity.Wrap(tail)];
 				return true;
 			}
 
 			return false;
 		}
 
-		auto TryPeek() noexcept -> std::optional<value_type>
+		auto TryPeek() noexcept(std::is_nothrow_copy_constructible_v<value_type>)
+			-> std::optional<value_type>
 		{
-			value_type elem;
-			if (TryPeek(elem))
-				return elem;
+			auto tail = m_local_tail;
+
+			if (used_count_cached(tail, 1) != 0)
+				return get_queue_data()[m_capacity.Wrap(tail)];
+
 			return {};
 		}
 
-		[[nodiscard]] auto IsFull() const noexcept -> bool
-		{
-			return is_full(sizeof(size_type) + 1);
-		}
+		// Publish the pushes deferred so far. With deferred publication, producer must call this
+		// once it stops pushing, or the consumer never sees the last elements, however long it
+		// waits.
+		void Flush() noexcept { detail::store_release(m_head, m_local_head); }
+
+		// Publish the pops deferred so far. Consumer must call this once it stops popping, for the
+		// producer to reuse the last slots.
+		void FlushPop() noexcept { detail::store_release(m_tail, m_local_tail); }
+
+		// With deferred publication, only published pushes and pops are accounted.
+		[[nodiscard]] auto IsFull() const noexcept -> bool { return is_full(); }
 
 		[[nodiscard]] auto IsEmpty() const noexcept -> bool { return is_empty(); }
 
 	private:
-		explicit SPSCQueue(size_type elemcount) noexcept : m_queue_size(elemcount) {}
+		// Elements can be moved through `OutputIt` without throwing. Writing through an arbitrary
+		// iterator, like a `std::back_inserter`, may allocate.
+		template <typename OutputIt>
+		static constexpr bool IS_NOTHROW_OUTPUT =
+			std::is_nothrow_assignable_v<decltype(*std::declval<OutputIt&>()), value_type&&> &&
+			noexcept(++std::declval<OutputIt&>()) &&
+			std::is_nothrow_copy_constructible_v<OutputIt> &&
+			std::is_nothrow_move_constructible_v<OutputIt>;
+
+		explicit SPSCQueue(size_type elemcount, size_type publish_batch) noexcept
+			: m_capacity(elemcount), m_publish_batch(publish_batch)
+		{
+			assert(publish_batch != 0);
+		}
 
 
 		[[nodiscard]] auto is_full() const noexcept -> bool
@@ -291,7 +657,36 @@ namespace lockfree
 		}
 		[[nodiscard]] auto is_full(size_type head, size_type tail) const noexcept -> bool
 		{
-			return head - tail >= m_queue_size;
+			return head - tail >= m_capacity.Size();
+		}
+
+		// Producer only. Number of free slots, re-reading `m_tail` only when the cached copy
+		// shows less than `wanted` free slots.
+		auto free_count_cached(size_type head, size_type wanted) noexcept -> size_type
+		{
+			if (m_capacity.Size() - (head - m_cached_tail) < wanted)
+			{
+				m_cached_tail = detail::load_acquire(m_tail);
+				if (head - m_cached_tail == m_capacity.Size())
+					on_full();
+			}
+
+			return m_capacity.Size() - (head - m_cached_tail);
+		}
+
+		// Consumer only. Number of filled slots, re-reading `m_head` only when the cached copy
+		// shows less than `wanted` filled slots.
+		auto used_count_cached(size_type tail, size_type wanted) noexcept -> size_type
+		{
+			assert(tail <= m_cached_head);
+			if (m_cached_head - tail < wanted)
+			{
+				m_cached_head = detail::load_acquire(m_head);
+				if (m_cached_head == tail)
+					on_empty();
+			}
+
+			return m_cached_head - tail;
 		}
 
 		[[nodiscard]] auto is_empty() const noexcept -> bool
@@ -303,6 +698,70 @@ namespace lockfree
 			return tail == head;
 		}
 
+		// Producer only. With deferred publication, `head` is published only when `m_publish_batch`
+		// pushes are pending, or when the consumer is waiting on an empty queue.
+		void publish_head(size_type head) noexcept
+		{
+			m_local_head = head;
+
+			if (m_publish_batch != 1)
+			{
+				set_waiting(m_producer_waiting, false);
+				if (head - detail::load_relaxed(m_head) < m_publish_batch &&
+					!detail::load_relaxed(m_consumer_waiting))
+				{
+					return;
+				}
+			}
+
+			detail::store_release(m_head, head);
+		}
+
+		// Consumer only. Counterpart of `publish_head`.
+		void publish_tail(size_type tail) noexcept
+		{
+			m_local_tail = tail;
+
+			if (m_publish_batch != 1)
+			{
+				set_waiting(m_consumer_waiting, false);
+				if (tail - detail::load_relaxed(m_tail) < m_publish_batch &&
+					!detail::load_relaxed(m_producer_waiting))
+				{
+					return;
+				}
+			}
+
+			detail::store_release(m_tail, tail);
+		}
+
+		// Producer found the queue full. Publish the pending pushes, so that the consumer can pop
+		// them, and ask the consumer to publish its pops right away.
+		void on_full() noexcept
+		{
+			if (m_publish_batch != 1)
+			{
+				Flush();
+				set_waiting(m_producer_waiting, true);
+			}
+		}
+
+		// Consumer found the queue empty. Counterpart of `on_full`.
+		void on_empty() noexcept
+		{
+			if (m_publish_batch != 1)
+			{
+				FlushPop();
+				set_waiting(m_consumer_waiting, true);
+			}
+		}
+
+		static void set_waiting(std::atomic<bool>& waiting, bool val) noexcept
+		{
+			if (detail::load_relaxed(waiting) != val)
+				waiting.store(val, std::memory_order_relaxed);
+		}
+
 
 		auto get_queue_data() noexcept -> value_type*
 		{
@@ -315,10 +774,17 @@ namespace lockfree
 			return const_cast<SPSCQueue*>(this)->get_queue_data();
 		}
 
-		const size_type m_queue_size;
+		const Capacity m_capacity;
+		const size_type m_publish_batch;
 
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_head = 0;
+		std::atomic<bool> m_producer_waiting = false; // Producer found the queue full
+		alignas(detail::CACHELINESIZE) size_type m_cached_tail = 0; // Producer's copy of `m_tail`
+		size_type m_local_head = 0; // `m_head`, including unpublished pushes
 		alignas(detail::CACHELINESIZE) std::atomic<size_type> m_tail = 0;
+		std::atomic<bool> m_consumer_waiting = false; // Consumer found the queue empty
+		alignas(detail::CACHELINESIZE) size_type m_cached_head = 0; // Consumer's copy of `m_head`
+		size_type m_local_tail = 0; // `m_tail`, including unpublished pops
 	};
 
 	namespace thread
@@ -327,9 +793,17 @@ namespace lockfree
 		{
 		public:
 			using size_type = lockfree::SPSCQueueAny::size_type;
-
-			explicit SPSCQueueAny(size_type queue_size)
-				: m_queue(detail::MakeAndInitialize<lockfree::SPSCQueueAny>(queue_size))
+			using WriteRegion = lockfree::SPSCQueueAny::WriteRegion;
+			using ReadRegion = lockfree::SPSCQueueAny::ReadRegion;
+
+			// For `publish_batch` > 1, see `lockfree::SPSCQueueAny::Initialize`. Producer must
+			// `Flush` once it stops pushing.
+			explicit SPSCQueueAny(size_type queue_size, bool mirrored = false,
+				const Framing& framing = {}, size_type publish_batch = 1)
+				: m_queue(mirrored ? detail::MakeAndInitializeMirrored<lockfree::SPSCQueueAny>(
+										 queue_size, framing, publish_batch)
+								   : detail::MakeAndInitialize<lockfree::SPSCQueueAny>(
+										 queue_size, framing, publish_batch))
 			{
 			}
 
@@ -344,6 +818,13 @@ namespace lockfree
 				return m_queue->TryPush(elem.data(), elem.length());
 			}
 
+			auto Reserve(size_type elemsize) noexcept -> std::optional<WriteRegion>
+			{
+				return m_queue->Reserve(elemsize);
+			}
+			void Commit(size_type elemsize) noexcept { m_queue->Commit(elemsize); }
+			void Abort() noexcept { m_queue->Abort(); }
+
 			auto GetNextElementSize() noexcept -> std::optional<size_type>
 			{
 				return m_queue->GetNextElementSize();
@@ -361,6 +842,12 @@ namespace lockfree
 				return m_queue->TryPeek(elem, req_elemsize);
 			}
 
+			auto TryRead() noexcept -> std::optional<ReadRegion> { return m_queue->TryRead(); }
+			void Consume() noexcept { m_queue->Consume(); }
+
+			void Flush() noexcept { m_queue->Flush(); }
+			void FlushPop() noexcept { m_queue->FlushPop(); }
+
 			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
 
 			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
@@ -369,34 +856,143 @@ namespace lockfree
 			std::shared_ptr<lockfree::SPSCQueueAny> m_queue;
 		};
 
-		template <typename T> class SPSCQueue
+		template <typename T, typename Capacity = DynamicCapacity> class SPSCQueue
 		{
 		public:
-			using size_type = typename lockfree::SPSCQueue<T>::size_type;
-			using value_type = typename lockfree::SPSCQueue<T>::value_type;
+			using size_type = typename lockfree::SPSCQueue<T, Capacity>::size_type;
+			using value_type = typename lockfree::SPSCQueue<T, Capacity>::value_type;
+
+			// For `publish_batch` > 1, see `lockfree::SPSCQueue::Initialize`. Producer must `Flush`
+			// once it stops pushing.
+			explicit SPSCQueue(size_type elem_count, size_type publish_batch = 1)
+				: m_queue(detail::MakeAndInitialize<lockfree::SPSCQueue<T, Capacity>>(
+					  elem_count, publish_batch))
+			{
+			}
+
+			template <typename... Args> auto TryEmplace(Args&&... args) -> bool
+			{
+				return m_queue->TryEmplace(std::forward<Args>(args)...);
+			}
 
-			explicit SPSCQueue(size_type elem_count)
-				: m_queue(detail::MakeAndInitialize<lockfree::SPSCQueue<T>>(elem_count))
+			auto TryPush(const value_type& val) -> bool { return m_queue->TryPush(val); }
+			auto TryPush(value_type&& val) noexcept -> bool
 			{
+				return m_queue->TryPush(std::move(val));
 			}
 
-			auto TryPush(const value_type& val) noexcept -> bool { return m_queue->TryPush(val); }
+			template <typename ForwardIt>
+			auto TryPushN(ForwardIt first, ForwardIt last) -> size_type
+			{
+				return m_queue->TryPushN(first, last);
+			}
+			auto TryPushN(const value_type* vals, size_type count) -> size_type
+			{
+				return m_queue->TryPushN(vals, count);
+			}
 
 			auto TryPop() noexcept -> std::optional<value_type> { return m_queue->TryPop(); }
-			auto TryPeek() noexcept -> std::optional<value_type> { return m_queue->TryPeek(); }
+			auto TryPeek() -> std::optional<value_type> { return m_queue->TryPeek(); }
 
 			// Use this variant to avoid need to double copy.
-			auto TryPop(value_type& outval) noexcept -> bool { return m_queue->TryPop(outval); }
+			auto TryPop(value_type& outval) -> bool { return m_queue->TryPop(outval); }
 
 			// Use this variant to avoid need to double copy.
-			auto TryPeek(value_type& outval) noexcept -> bool { return m_queue->TryPeek(outval); }
+			auto TryPeek(value_type& outval) -> bool { return m_queue->TryPeek(outval); }
+
+			template <typename OutputIt> auto TryPopN(OutputIt out, size_type count) -> size_type
+			{
+				return m_queue->TryPopN(out, count);
+			}
+
+			void Flush() noexcept { m_queue->Flush(); }
+			void FlushPop() noexcept { m_queue->FlushPop(); }
 
 			auto IsEmpty() noexcept -> bool { return m_queue->IsEmpty(); }
 
 			auto IsFull() noexcept -> bool { return m_queue->IsFull(); }
 
 		private:
-			std::shared_ptr<lockfree::SPSCQueue<T>> m_queue;
+			std::shared_ptr<lockfree::SPSCQueue<T, Capacity>> m_queue;
+		};
+	}
+
+	// Queues with compile time capacity, whose ring buffer is stored inline. They can be used as
+	// members or statics, without any allocation or pointer chasing.
+	namespace fixed
+	{
+		template <typename T, std::size_t N> class SPSCQueue
+		{
+			using queue_type = lockfree::SPSCQueue<T, FixedCapacity<N>>;
+
+		public:
+			using size_type = typename queue_type::size_type;
+			using value_type = typename queue_type::value_type;
+
+			// For `publish_batch` > 1, see `lockfree::SPSCQueue::Initialize`. Producer must `Flush`
+			// once it stops pushing.
+			explicit SPSCQueue(size_type publish_batch = 1) noexcept
+			{
+				queue_type::Initialize(m_storage.data(), N, publish_batch);
+			}
+
+			~SPSCQueue() { queue_type::Destroy(queue()); }
+
+			SPSCQueue(const SPSCQueue&) = delete;
+			SPSCQueue(SPSCQueue&&) = delete;
+			auto operator=(const SPSCQueue&) -> SPSCQueue& = delete;
+			auto operator=(SPSCQueue&&) -> SPSCQueue& = delete;
+
+			template <typename... Args> auto TryEmplace(Args&&... args) -> bool
+			{
+				return queue()->TryEmplace(std::forward<Args>(args)...);
+			}
+
+			auto TryPush(const value_type& val) -> bool { return queue()->TryPush(val); }
+			auto TryPush(value_type&& val) noexcept -> bool
+			{
+				return queue()->TryPush(std::move(val));
+			}
+
+			template <typename ForwardIt>
+			auto TryPushN(ForwardIt first, ForwardIt last) -> size_type
+			{
+				return queue()->TryPushN(first, last);
+			}
+			auto TryPushN(const value_type* vals, size_type count) -> size_type
+			{
+				return queue()->TryPushN(vals, count);
+			}
+
+			auto TryPop() noexcept -> std::optional<value_type> { return queue()->TryPop(); }
+			auto TryPeek() -> std::optional<value_type> { return queue()->TryPeek(); }
+
+			// Use this variant to avoid need to double copy.
+			auto TryPop(value_type& outval) -> bool { return queue()->TryPop(outval); }
+
+			// Use this variant to avoid need to double copy.
+			auto TryPeek(value_type& outval) -> bool { return queue()->TryPeek(outval); }
+
+			template <typename OutputIt> auto TryPopN(OutputIt out, size_type count) -> size_type
+			{
+				return queue()->TryPopN(out, count);
+			}
+
+			void Flush() noexcept { queue()->Flush(); }
+			void FlushPop() noexcept { queue()->FlushPop(); }
+
+			auto IsEmpty() noexcept -> bool { return queue()->IsEmpty(); }
+
+			auto IsFull() noexcept -> bool { return queue()->IsFull(); }
+
+		private:
+			auto queue() noexcept -> queue_type*
+			{
+				return std::launder(reinterpret_cast<queue_type*>(m_storage.data()));
+			}
+
+			alignas(queue_type::GetAlignment())
+				std::array<std::byte, queue_type::CalculateSize(N)> m_storage;
 		};
 	}
 }
\ No newline at end of file
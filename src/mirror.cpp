@@ -0,0 +1,65 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "lockfree-queue/detail/defs.h"
+#include "lockfree-queue/detail/scopeexit.h"
+
+namespace lockfree::detail
+{
+	static auto mapping_size(const MirroredLayout& layout) noexcept -> std::size_t
+	{
+		return (layout.header_size + 2 * layout.ring_size) * layout.num_rings;
+	}
+
+	auto page_size() noexcept -> std::size_t
+	{
+		static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+		return size;
+	}
+
+	// Each block's header and ring buffer are backed by consecutive pages of a memfd. The ring
+	// buffer's pages are mapped a second time, right after the first mapping.
+	auto map_mirrored(const MirroredLayout& layout) noexcept -> void*
+	{
+		const auto file_block_size = layout.header_size + layout.ring_size;
+		const auto block_size = file_block_size + layout.ring_size;
+
+		auto fd = memfd_create("lockfree-queue", MFD_CLOEXEC);
+		if (fd == -1)
+			return nullptr;
+
+		SCOPE_EXIT([&] { close(fd); });
+
+		if (ftruncate(fd, static_cast<off_t>(file_block_size * layout.num_rings)) != 0)
+			return nullptr;
+
+		// Reserve the address range first, so that the blocks can be placed at fixed addresses.
+		auto* mem =
+			mmap(nullptr, mapping_size(layout), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED)
+			return nullptr;
+
+		for (std::size_t i = 0; i < layout.num_rings; i++)
+		{
+			auto* block = static_cast<char*>(mem) + block_size * i;
+			const auto offset = static_cast<off_t>(file_block_size * i);
+
+			if (mmap(block, file_block_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+					offset) == MAP_FAILED ||
+				mmap(block + file_block_size, layout.ring_size, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_FIXED, fd,
+					offset + static_cast<off_t>(layout.header_size)) == MAP_FAILED)
+			{
+				munmap(mem, mapping_size(layout));
+				return nullptr;
+			}
+		}
+
+		return mem;
+	}
+
+	void unmap_mirrored(void* mem, const MirroredLayout& layout) noexcept
+	{
+		munmap(mem, mapping_size(layout));
+	}
+}
@@ -137,6 +137,8 @@ namespace lockfree
 		static thread_local const auto* cs = create_crit_section();
 		const auto percpu_queue_size = m_percpu_queue_size;
 		const auto per_cpu_ring_buf_size = m_per_cpu_ring_buf_size;
+		const auto per_cpu_ring_buf_mask = m_per_cpu_ring_buf_mask;
+		const auto per_cpu_ring_buf_span = m_per_cpu_ring_buf_span;
 		auto res = false;
 		auto* self = this;
 
@@ -227,25 +229,36 @@ namespace lockfree
 
 			// Copy Element to Ring Buffer
 			R"(
+				// Wrap head using mask, when ring buffer size is a power of two.
 				mov %[head], %%rax
+				mov %[per_cpu_ring_buf_mask], %%rdx
+				test %%rdx, %%rdx
+				jz div%=
+				and %%rax, %%rdx
+				jmp wrapped%=
+			div%=:
 				xor %%rdx, %%rdx
 				divq %[per_cpu_ring_buf_size]
+			wrapped%=:
 
 				// r8 = `elemsize` start pos
 				mov %%rdx, %%r8
-				mov %%rdx, %%rax
-				add %[qword_sz], %%rax
-				xor %%rdx, %%rdx
-				divq %[per_cpu_ring_buf_size]
-				// r9 = `elem` start pos
-				mov %%rdx, %%r9
 
-				mov %[per_cpu_ring_buf_size], %%rax
+				// r9 = `elem` start pos, wrapped without division
+				mov %%rdx, %%r9
+				add %[qword_sz], %%r9
+				mov %%r9, %%rax
+				sub %[per_cpu_ring_buf_size], %%rax
+				cmp %[per_cpu_ring_buf_size], %%r9
+				cmovae %%rax, %%r9
+
+				// Copies split only where the ring buffer ends, i.e. never, when it is mirrored.
+				mov %[per_cpu_ring_buf_span], %%rax
 				lea %[elemsize], %%rdi
 				mov %[qword_sz], %%rsi
 				copy_to_ring_buf %%rcx, %%r8, %%rax, %%rdi, %%rsi, %%r11, %%xmm0, %%rdx, %%r10, %%r12
 
-				mov %[per_cpu_ring_buf_size], %%rax
+				mov %[per_cpu_ring_buf_span], %%rax
 				mov %[elem], %%rdi
 				mov %[elemsize], %%rsi
 				copy_to_ring_buf %%rcx, %%r9, %%rax, %%rdi, %%rsi, %%r11, %%xmm0, %%rdx, %%r10, %%r12
@@ -281,6 +294,8 @@ namespace lockfree
 			: [this_] "m"(self), [elem] "m"(elem), [elemsize] "m"(elemsize), [cs] "m"(cs),
 			[mpsc_sz] "i"(sizeof(MPSCPCQueueAny)), [percpu_queue_size] "m"(percpu_queue_size),
 			[per_cpu_ring_buf_size] "m"(per_cpu_ring_buf_size),
+			[per_cpu_ring_buf_mask] "m"(per_cpu_ring_buf_mask),
+			[per_cpu_ring_buf_span] "m"(per_cpu_ring_buf_span),
 			[rseq_cpu_start] "m"(RestartableSequence::GetRseqCpuIdStart()),
 			[cpu_now] "m"(RestartableSequence::GetRseqCpuId()),
 			[head_off] "i"(offsetof(SPSCQueueAny, m_head)),
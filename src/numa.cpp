@@ -0,0 +1,142 @@
+#include <array>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#include "lockfree-queue/detail/numa.h"
+
+namespace lockfree::detail
+{
+	static constexpr auto NODE_DIR = "/sys/devices/system/node/node";
+
+	// Calls `fn(first, last)` for every range of a list like "0-3,8,10-11".
+	template <typename Fn> static void for_each_range(const std::string& list, Fn&& fn)
+	{
+		std::size_t pos = 0;
+
+		while (pos < list.size())
+		{
+			std::size_t len;
+			const auto first = std::stoi(list.substr(pos), &len);
+			auto last = first;
+
+			pos += len;
+			if (pos < list.size() && list[pos] == '-')
+			{
+				last = std::stoi(list.substr(pos + 1), &len);
+				pos += len + 1;
+			}
+
+			fn(first, last);
+			pos = list.find(',', pos);
+			if (pos == std::string::npos)
+				break;
+			pos++;
+		}
+	}
+
+	static auto read_line(const std::string& path) -> std::string
+	{
+		std::ifstream file(path);
+		std::string line;
+
+		std::getline(file, line);
+		return line;
+	}
+
+	// Node ids are the kernel's, which may have gaps, like "0,2". Nodes are the indexes into
+	// `node_ids`.
+	struct Topology
+	{
+		std::vector<int> node_ids = { 0 };
+		std::vector<int> cpu_nodes; // Node of every cpu
+	};
+
+	static auto read_topology() noexcept -> Topology
+	{
+		Topology topology;
+
+		try
+		{
+			topology.node_ids.clear();
+			for_each_range(read_line("/sys/devices/system/node/online"), [&](int first, int last) {
+				for (int id = first; id <= last; id++)
+					topology.node_ids.push_back(id);
+			});
+
+			if (topology.node_ids.empty())
+				return {};
+
+			for (int node = 0; node < int(topology.node_ids.size()); node++)
+			{
+				const auto id = topology.node_ids[node];
+
+				for_each_range(read_line(NODE_DIR + std::to_string(id) + "/cpulist"),
+					[&](int first, int last) {
+						if (topology.cpu_nodes.size() <= std::size_t(last))
+							topology.cpu_nodes.resize(last + 1, 0);
+						for (int cpu = first; cpu <= last; cpu++)
+							topology.cpu_nodes[cpu] = node;
+					});
+			}
+		}
+		catch (...)
+		{
+			return {};
+		}
+
+		return topology;
+	}
+
+	static auto topology() noexcept -> const Topology&
+	{
+		static const auto topology = read_topology();
+		return topology;
+	}
+
+	auto numa_num_nodes() noexcept -> int { return int(topology().node_ids.size()); }
+
+	auto numa_current_node() noexcept -> int
+	{
+		const auto& cpu_nodes = topology().cpu_nodes;
+		const auto cpu = sched_getcpu();
+
+		if (cpu < 0 || std::size_t(cpu) >= cpu_nodes.size())
+			return 0;
+
+		return cpu_nodes[cpu];
+	}
+
+	// Preferred, rather than bound, policy lets the pages fall back to the other nodes, when the
+	// node runs out of memory. Policy is only a hint, so failure to set it is ignored, and so are
+	// node ids past the largest the kernel can be built with.
+	auto numa_alloc_onnode(std::size_t size, int node) noexcept -> void*
+	{
+		constexpr std::size_t MAX_NODE_IDS = 1024;
+		constexpr auto BITS = 8 * sizeof(unsigned long);
+
+		auto* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED)
+			return nullptr;
+
+		const auto id = std::size_t(topology().node_ids[node]);
+		if (numa_num_nodes() > 1 && id < MAX_NODE_IDS)
+		{
+			std::array<unsigned long, MAX_NODE_IDS / BITS> nodemask = {};
+
+			nodemask[id / BITS] = 1UL << (id % BITS);
+			// Kernel reads only `maxnode - 1` bits of the mask.
+			syscall(SYS_mbind, mem, size, MPOL_PREFERRED, nodemask.data(),
+				nodemask.size() * BITS + 1, 0);
+		}
+
+		return mem;
+	}
+
+	void numa_free(void* mem, std::size_t size) noexcept { munmap(mem, size); }
+}
@@ -1,10 +1,19 @@
+#include <algorithm>
 #include <array>
+#include <cstdint>
+#include <cstring>
 #include <doctest/doctest.h>
+#include <memory>
+#include <string>
 #include <string_view>
 
 #include <lockfree-queue/mpmc.h>
+#include <lockfree-queue/mpmc_numa.h>
+#include <lockfree-queue/mpmc_partitioned.h>
 #include <lockfree-queue/mpsc.h>
+#include <lockfree-queue/mpsc_lanes.h>
 #include <lockfree-queue/mpsc_pc.h>
+#include <lockfree-queue/mpsc_unbounded.h>
 #include <lockfree-queue/spsc.h>
 
 #include "string-gen.h"
@@ -33,32 +42,1033 @@ TEST_SUITE("MPMC") // NOLINT
 
 		REQUIRE(queue.TryPop(0, val) == false);
 	}
+
+	TEST_CASE("PowerOfTwoCapacity")
+	{
+		MPMCQueue<int, lockfree::PowerOfTwoCapacity> queue(1, 2);
+		int val;
+
+		for (int i = 0; i < 5; i++)
+		{
+			REQUIRE(queue.TryPush(0, i) == true);
+			REQUIRE(queue.TryPush(0, i + 1) == true);
+			REQUIRE(queue.TryPush(0, i + 2) == false);
+
+			REQUIRE(queue.TryPop(0, val) == true);
+			REQUIRE(val == i);
+			REQUIRE(queue.TryPop(0, val) == true);
+			REQUIRE(val == i + 1);
+			REQUIRE(queue.TryPop(0, val) == false);
+		}
+	}
+
+	TEST_CASE("ThreadPid")
+	{
+		constexpr auto TEST_ITER = 10000;
+
+		MPMCQueue<int> queue(2, 10);
+
+		std::thread producer{ [queue]() mutable {
+			const auto pid = queue.ThreadPid().value();
+
+			for (int i = 0; i < TEST_ITER; i++)
+			{
+				while (!queue.TryPush(pid, i))
+					std::this_thread::yield();
+			}
+		} };
+
+		const auto pid = queue.ThreadPid().value();
+		int val;
+
+		for (int i = 0; i < TEST_ITER; i++)
+		{
+			while (!queue.TryPop(pid, val))
+				std::this_thread::yield();
+
+			REQUIRE(val == i);
+		}
+
+		producer.join();
+	}
+
+	TEST_CASE("Batch")
+	{
+		MPMCQueue<int> queue(1, 5);
+		std::array<int, 4> in = {};
+		std::array<int, 4> out = {};
+
+		for (int i = 0; i < 5; i++)
+		{
+			for (size_t j = 0; j < in.size(); j++)
+				in[j] = i * 10 + static_cast<int>(j);
+
+			// Partial success, when the queue runs out of space or elements.
+			REQUIRE(queue.TryPushN(0, in.data(), in.size()) == 4);
+			REQUIRE(queue.TryPushN(0, in.data(), in.size()) == 1);
+			REQUIRE(queue.TryPushN(0, in.data(), in.size()) == 0);
+
+			REQUIRE(queue.TryPopN(0, out.data(), 3) == 3);
+			REQUIRE(out[0] == in[0]);
+			REQUIRE(out[2] == in[2]);
+			REQUIRE(queue.TryPopN(0, out.data(), out.size()) == 2);
+			REQUIRE(out[0] == in[3]);
+			REQUIRE(out[1] == in[0]);
+			REQUIRE(queue.TryPopN(0, out.data(), out.size()) == 0);
+		}
+	}
+
+	TEST_CASE("PaddedLayout")
+	{
+		// Batches of 3 wrap around the ring buffer of 4. Batches may be split, when the cached
+		// positions lag.
+		MPMCQueue<int, lockfree::DynamicCapacity, lockfree::PaddedLayout> queue(1, 4);
+		std::array<int, 3> out = {};
+
+		for (int i = 0; i < 5; i++)
+		{
+			const std::array<int, 3> in = { i, i + 1, i + 2 };
+
+			for (size_t pushed = 0; pushed < in.size();)
+			{
+				const auto count = queue.TryPushN(0, in.data() + pushed, in.size() - pushed);
+				REQUIRE(count != 0);
+				pushed += count;
+			}
+			for (size_t popped = 0; popped < out.size();)
+			{
+				const auto count = queue.TryPopN(0, out.data() + popped, out.size() - popped);
+				REQUIRE(count != 0);
+				popped += count;
+			}
+
+			REQUIRE(out == in);
+			REQUIRE(queue.IsEmpty() == true);
+		}
+	}
+
+	TEST_CASE("Combined")
+	{
+		MPMCQueue<int> queue(2, 2);
+		int val;
+
+		REQUIRE(queue.TryPushCombined(0, 1) == true);
+		REQUIRE(queue.TryPushCombined(1, 2) == true);
+		REQUIRE(queue.TryPushCombined(0, 3) == false);
+
+		REQUIRE(queue.TryPop(1, val) == true);
+		REQUIRE(val == 1);
+		REQUIRE(queue.TryPop(1, val) == true);
+		REQUIRE(val == 2);
+		REQUIRE(queue.TryPop(1, val) == false);
+	}
+
+	TEST_CASE("Seq")
+	{
+		constexpr auto NUM_PRODUCERS = 2;
+		constexpr auto NUM_CONSUMERS = 2;
+		constexpr auto TEST_ITER = 10000;
+
+		MPMCSeqQueue<int> queue(NUM_PRODUCERS + NUM_CONSUMERS, 2);
+		int val;
+
+		REQUIRE(queue.TryPush(0, 1) == true);
+		REQUIRE(queue.TryPush(0, 2) == true);
+		REQUIRE(queue.TryPush(0, 3) == false);
+		REQUIRE(queue.IsFull() == true);
+		REQUIRE(queue.TryPop(1, val) == true);
+		REQUIRE(val == 1);
+		REQUIRE(queue.TryPop(1, val) == true);
+		REQUIRE(val == 2);
+		REQUIRE(queue.TryPop(1, val) == false);
+
+		std::vector<std::thread> threads;
+		std::array<std::array<int, NUM_PRODUCERS>, NUM_CONSUMERS> num_popped = {};
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+		{
+			threads.emplace_back([queue, pid]() mutable {
+				for (int i = 0; i < TEST_ITER; i++)
+				{
+					while (!queue.TryPush(pid, pid * TEST_ITER + i))
+						std::this_thread::yield();
+				}
+			});
+		}
+		for (int c = 0; c < NUM_CONSUMERS; c++)
+		{
+			threads.emplace_back([queue, &num_popped, c]() mutable {
+				// Tickets of a consumer increase, so it sees every producer's elements in order.
+				std::array<int, NUM_PRODUCERS> next = {};
+				int val;
+
+				for (int i = 0; i < NUM_PRODUCERS * TEST_ITER / NUM_CONSUMERS; i++)
+				{
+					while (!queue.TryPop(NUM_PRODUCERS + c, val))
+						std::this_thread::yield();
+
+					REQUIRE(val % TEST_ITER >= next[val / TEST_ITER]);
+					next[val / TEST_ITER] = val % TEST_ITER + 1;
+					num_popped[c][val / TEST_ITER]++;
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+			REQUIRE(num_popped[0][pid] + num_popped[1][pid] == TEST_ITER);
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("WaitFree")
+	{
+		constexpr auto NUM_PROCESSES = 4;
+		constexpr auto QUEUE_SIZE = 64;
+		constexpr auto MAX_BATCH = 7;
+		constexpr auto TEST_ITER = 10000;
+
+		MPMCWaitFreeQueue<int> queue(2, 3);
+		std::array<int, 3> vals = { 1, 2, 3 };
+		std::array<int, 3> out = {};
+
+		REQUIRE(queue.TryPushN(0, vals.data(), 2) == 2);
+		REQUIRE(queue.TryPushN(0, vals.data() + 2, 2) == 1);
+		REQUIRE(queue.IsFull() == true);
+		REQUIRE(queue.TryPush(0, 4) == false);
+		REQUIRE(queue.TryPopN(1, out.data(), 3) == 3);
+		REQUIRE(out == vals);
+		REQUIRE(queue.IsEmpty() == true);
+		REQUIRE(queue.TryPop(1, out[0]) == false);
+
+		// Batches race with the opposite operations of a single process, whose finished
+		// operations are below every position in use. So the elements, or slots, they left can't
+		// be held up by a slow peer, and a batch, which reserved some of them, must not fail.
+		MPMCWaitFreeQueue<int> batched(NUM_PROCESSES + 1, QUEUE_SIZE);
+		constexpr auto SINGLE = NUM_PROCESSES;
+
+		// Reserves upto `count` of the `limit` elements, or slots. Returns the number reserved.
+		auto reserve = [](std::atomic<int>& reserved, int count, int limit) {
+			auto old = reserved.load();
+
+			do
+			{
+				count = std::min(count, limit - old);
+			} while (count != 0 && !reserved.compare_exchange_weak(old, old + count));
+
+			return count;
+		};
+
+		// Pops race, with a single producer.
+		{
+			std::atomic<int> num_pushed = 0;
+			std::atomic<int> num_reserved = 0;
+			std::atomic<long> sum = 0;
+			std::vector<std::thread> threads;
+
+			threads.emplace_back([batched, &num_pushed]() mutable {
+				std::array<int, MAX_BATCH> batch = {};
+
+				for (int i = 0; i < TEST_ITER;)
+				{
+					const auto count = std::min(int{ MAX_BATCH }, TEST_ITER - i);
+					for (int j = 0; j < count; j++)
+						batch[j] = i + j;
+
+					const auto n = int(batched.TryPushN(SINGLE, batch.data(), count));
+					if (n == 0)
+						std::this_thread::yield();
+
+					i += n;
+					num_pushed += n;
+				}
+			});
+			for (int pid = 0; pid < NUM_PROCESSES; pid++)
+			{
+				threads.emplace_back(
+					[batched, &reserve, &num_pushed, &num_reserved, &sum, pid]() mutable {
+						std::array<int, MAX_BATCH> batch = {};
+
+						for (int i = 0; num_reserved < TEST_ITER; i++)
+						{
+							const auto count =
+								reserve(num_reserved, 1 + (pid + i) % MAX_BATCH, num_pushed);
+							if (count == 0)
+							{
+								std::this_thread::yield();
+								continue;
+							}
+
+							const auto n = int(batched.TryPopN(pid, batch.data(), count));
+							REQUIRE(n != 0);
+
+							num_reserved -= count - n;
+							for (int j = 0; j < n; j++)
+								sum += batch[j];
+						}
+					});
+			}
+
+			for (auto& thread : threads)
+				thread.join();
+
+			REQUIRE(sum == long{ TEST_ITER } * (TEST_ITER - 1) / 2);
+			REQUIRE(batched.IsEmpty() == true);
+		}
+
+		// Pushes race, with a single consumer.
+		{
+			std::atomic<int> num_popped = 0;
+			std::atomic<int> num_reserved = 0;
+			std::atomic<long> pushed_sum = 0;
+			std::atomic<long> popped_sum = 0;
+			std::vector<std::thread> threads;
+
+			threads.emplace_back([batched, &num_popped, &popped_sum]() mutable {
+				std::array<int, MAX_BATCH> batch = {};
+
+				while (num_popped < TEST_ITER)
+				{
+					const auto n = int(batched.TryPopN(SINGLE, batch.data(), MAX_BATCH));
+					if (n == 0)
+						std::this_thread::yield();
+
+					for (int j = 0; j < n; j++)
+						popped_sum += batch[j];
+					num_popped += n;
+				}
+			});
+			for (int pid = 0; pid < NUM_PROCESSES; pid++)
+			{
+				threads.emplace_back([batched, &reserve, &num_popped, &num_reserved, &pushed_sum,
+										 pid]() mutable {
+					std::array<int, MAX_BATCH> batch = {};
+					batch.fill(pid + 1);
+
+					for (int i = 0; num_reserved < TEST_ITER; i++)
+					{
+						const auto limit = std::min(int{ TEST_ITER }, QUEUE_SIZE + num_popped);
+						const auto count =
+							reserve(num_reserved, 1 + (pid + i) % MAX_BATCH, limit);
+						if (count == 0)
+						{
+							std::this_thread::yield();
+							continue;
+						}
+
+						const auto n = int(batched.TryPushN(pid, batch.data(), count));
+						REQUIRE(n != 0);
+
+						num_reserved -= count - n;
+						pushed_sum += long{ n } * (pid + 1);
+					}
+				});
+			}
+
+			for (auto& thread : threads)
+				thread.join();
+
+			REQUIRE(popped_sum == pushed_sum);
+			REQUIRE(batched.IsEmpty() == true);
+		}
+	}
+
+	TEST_CASE("AnyBasic")
+	{
+		constexpr auto QLEN = 2 * sizeof(MPMCQueueAny::size_type) + 8;
+
+		constexpr std::string_view DATA1 = { "abcdef" };
+		constexpr std::string_view DATA2 = { "xyz" };
+
+		MPMCQueueAny queue(2, QLEN);
+		std::array<char, QLEN> outdata = {};
+
+		for (int i = 0; i < 5; i++)
+		{
+			REQUIRE(queue.TryPush(0, DATA1) == true);
+			REQUIRE(queue.TryPush(0, DATA2) == false);
+			REQUIRE(queue.IsFull() == false);
+
+			REQUIRE(queue.TryPop(1, outdata.data(), outdata.size()) == DATA1.length());
+			REQUIRE(std::string_view(outdata.data(), DATA1.length()) == DATA1);
+
+			// Element crossing the end of the ring buffer, popped into a smaller buffer.
+			REQUIRE(queue.TryPush(0, DATA2) == true);
+			REQUIRE(queue.TryPop(1, outdata.data(), 2) == DATA2.length());
+			REQUIRE(std::string_view(outdata.data(), 2) == DATA2.substr(0, 2));
+
+			REQUIRE(queue.TryPop(1, outdata.data(), outdata.size()).has_value() == false);
+			REQUIRE(queue.IsEmpty() == true);
+		}
+	}
+
+	TEST_CASE("AnyConcurrency")
+	{
+		static constexpr auto QSIZE = StringGen::AVGLEN * 10;
+		constexpr auto NUM_PRODUCERS = 2;
+		constexpr auto NUM_CONSUMERS = 2;
+		constexpr auto TEST_ITER = 2000;
+
+		MPMCQueueAny queue(NUM_PRODUCERS + NUM_CONSUMERS, QSIZE);
+		std::vector<std::thread> threads;
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+		{
+			threads.emplace_back([queue, pid]() mutable {
+				StringGen str;
+
+				for (int i = 0; i < TEST_ITER; i++)
+				{
+					const auto data = str();
+
+					while (!queue.TryPush(pid, data))
+						std::this_thread::yield();
+				}
+			});
+		}
+		for (int pid = NUM_PRODUCERS; pid < NUM_PRODUCERS + NUM_CONSUMERS; pid++)
+		{
+			threads.emplace_back([queue, pid]() mutable {
+				std::string data(QSIZE, '\0');
+
+				for (int i = 0; i < NUM_PRODUCERS * TEST_ITER / NUM_CONSUMERS; i++)
+				{
+					std::optional<MPMCQueueAny::size_type> size;
+
+					while (!(size = queue.TryPop(pid, data.data(), data.size())))
+						std::this_thread::yield();
+
+					REQUIRE(StringGen::Verify(std::string_view(data.data(), *size)) == true);
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("Numa")
+	{
+		constexpr auto TEST_ITER = 10000;
+
+		MPMCNumaQueue<int> queue(2, 10);
+		REQUIRE(queue.NumNodes() >= 1);
+
+		// Shards are drained, whichever node the consumer runs on.
+		std::thread producer{ [queue]() mutable {
+			for (int i = 0; i < TEST_ITER; i++)
+			{
+				while (!queue.TryPush(0, i))
+					std::this_thread::yield();
+			}
+		} };
+
+		long sum = 0;
+		int val;
+
+		for (int i = 0; i < TEST_ITER; i++)
+		{
+			while (!queue.TryPop(1, val))
+				std::this_thread::yield();
+
+			sum += val;
+		}
+
+		producer.join();
+		REQUIRE(sum == long{ TEST_ITER } * (TEST_ITER - 1) / 2);
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("Partitioned")
+	{
+		constexpr auto TEST_ITER = 20000;
+		constexpr auto NUM_KEYS = 16;
+
+		MPMCPartitionedQueue<int> queue(1, 4, 10, 2);
+		std::array<std::atomic<int>, NUM_KEYS> last_popped;
+		std::atomic<int> num_popped = 0;
+
+		for (auto& last : last_popped)
+			last = -1;
+
+		std::thread producer{ [queue]() mutable {
+			for (int i = 0; i < TEST_ITER; i++)
+			{
+				while (!queue.TryPush(0, i % NUM_KEYS, i))
+					std::this_thread::yield();
+			}
+		} };
+
+		// Elements of a key must come out in order, even across the reassignment.
+		auto consume = [&](int consumer, int until) {
+			int val;
+
+			while (num_popped < until)
+			{
+				if (!queue.TryPop(consumer, val))
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				auto& last = last_popped[val % NUM_KEYS];
+				REQUIRE(val > last.load(std::memory_order_relaxed));
+				last.store(val, std::memory_order_relaxed);
+				num_popped++;
+			}
+		};
+
+		// Consumer 0 hands its partitions over to consumer 1 half way, without draining them.
+		std::thread consumer0{ [&]() {
+			consume(0, TEST_ITER / 2);
+
+			for (int p = 0; p < queue.NumPartitions(); p++)
+			{
+				if (queue.Owner(p) == 0)
+					queue.Assign(p, 1);
+			}
+		} };
+
+		consume(1, TEST_ITER);
+
+		producer.join();
+		consumer0.join();
+
+		for (int p = 0; p < queue.NumPartitions(); p++)
+		{
+			REQUIRE(queue.Owner(p) == 1);
+			REQUIRE(queue.Depth(p) == 0);
+		}
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("SparseProcesses")
+	{
+		constexpr auto MAX_PROCESSES = 1024;
+		constexpr auto TEST_ITER = 10000;
+		constexpr auto PRODUCER = 5;
+		constexpr auto CONSUMER = 900;
+
+		MPMCQueue<int> queue(MAX_PROCESSES, 10);
+
+		std::thread producer{ [queue]() mutable {
+			for (int i = 0; i < TEST_ITER; i++)
+			{
+				while (!queue.TryPush(PRODUCER, i))
+					std::this_thread::yield();
+			}
+		} };
+
+		int val;
+		for (int i = 0; i < TEST_ITER; i++)
+		{
+			while (!queue.TryPop(CONSUMER, val))
+				std::this_thread::yield();
+
+			REQUIRE(val == i);
+		}
+
+		producer.join();
+		REQUIRE(queue.IsEmpty() == true);
+	}
 }
 
-TEST_SUITE("MPSC") // NOLINT
-{
-	TEST_CASE("Basic")
+TEST_SUITE("MPSC") // NOLINT
+{
+	TEST_CASE("Basic")
+	{
+		MPSCQueue<int> queue(1, 3);
+
+		REQUIRE(queue.TryPush(0, 1) == true);
+		REQUIRE(queue.TryPush(0, 2) == true);
+		REQUIRE(queue.TryPush(0, 3) == true);
+
+		REQUIRE(queue.TryPush(0, 4) == false);
+
+		int val;
+		REQUIRE(queue.TryPop(val) == true);
+		REQUIRE(val == 1);
+		REQUIRE(queue.TryPop(val) == true);
+		REQUIRE(val == 2);
+		REQUIRE(queue.TryPeek(val) == true);
+		REQUIRE(val == 3);
+		REQUIRE(queue.TryPop(val) == true);
+		REQUIRE(val == 3);
+
+		REQUIRE(queue.TryPeek(val) == false);
+		REQUIRE(queue.TryPop(val) == false);
+	}
+
+	TEST_CASE("Fixed")
+	{
+		constexpr auto NUM_PRODUCERS = 2;
+		constexpr auto TEST_ITER = 1000;
+
+		static lockfree::fixed::MPSCQueue<int, 64, NUM_PRODUCERS> queue;
+
+		auto produce = [](int pid) {
+			for (int i = 0; i < TEST_ITER; i++)
+			{
+				while (!queue.TryPush(pid, i))
+					std::this_thread::yield();
+			}
+		};
+
+		std::thread producer0{ produce, 0 };
+		std::thread producer1{ produce, 1 };
+		int sum = 0;
+		int val;
+
+		for (int i = 0; i < NUM_PRODUCERS * TEST_ITER; i++)
+		{
+			while (!queue.TryPop(val))
+				std::this_thread::yield();
+			sum += val;
+		}
+
+		producer0.join();
+		producer1.join();
+
+		REQUIRE(sum == NUM_PRODUCERS * (TEST_ITER * (TEST_ITER - 1) / 2));
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("Batch")
+	{
+		constexpr auto NUM_PRODUCERS = 2;
+		constexpr auto TEST_ITER = 10000;
+		constexpr auto BATCH_SIZE = 7;
+
+		MPSCQueue<int> queue(NUM_PRODUCERS, 10);
+
+		auto produce = [queue](int pid) mutable {
+			std::array<int, BATCH_SIZE> batch = {};
+
+			for (int i = 0; i < TEST_ITER;)
+			{
+				const auto count = std::min(int{ BATCH_SIZE }, TEST_ITER - i);
+				for (int j = 0; j < count; j++)
+					batch[j] = pid * TEST_ITER + i + j;
+
+				const auto pushed = queue.TryPushN(pid, batch.data(), count);
+				if (pushed == 0)
+					std::this_thread::yield();
+				i += static_cast<int>(pushed);
+			}
+		};
+
+		std::thread producer0{ produce, 0 };
+		std::thread producer1{ produce, 1 };
+		std::array<int, NUM_PRODUCERS> next = {};
+		std::array<int, BATCH_SIZE> batch = {};
+
+		for (int i = 0; i < NUM_PRODUCERS * TEST_ITER;)
+		{
+			const auto popped = queue.TryPopN(batch.data(), batch.size());
+			if (popped == 0)
+				std::this_thread::yield();
+
+			for (size_t j = 0; j < popped; j++)
+				REQUIRE(batch[j] % TEST_ITER == next[batch[j] / TEST_ITER]++);
+			i += static_cast<int>(popped);
+		}
+
+		producer0.join();
+		producer1.join();
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("PaddedLayout")
+	{
+		constexpr auto NUM_PRODUCERS = 2;
+		constexpr auto TEST_ITER = 10000;
+
+		MPSCQueue<int, lockfree::DynamicCapacity, lockfree::PaddedLayout> queue(NUM_PRODUCERS, 5);
+		std::vector<std::thread> producers;
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+		{
+			producers.emplace_back([queue, pid]() mutable {
+				for (int i = 0; i < TEST_ITER; i++)
+				{
+					while (!queue.TryPush(pid, pid * TEST_ITER + i))
+						std::this_thread::yield();
+				}
+			});
+		}
+
+		std::array<int, NUM_PRODUCERS> next = {};
+		std::array<int, 3> vals = {};
+
+		for (int popped = 0; popped < NUM_PRODUCERS * TEST_ITER;)
+		{
+			const auto count = popped % 2 == 0 ? queue.TryPop(vals[0]) ? 1 : 0
+											   : queue.TryPopN(vals.data(), vals.size());
+			if (count == 0)
+				std::this_thread::yield();
+
+			for (std::size_t i = 0; i < count; i++)
+				REQUIRE(vals[i] % TEST_ITER == next[vals[i] / TEST_ITER]++);
+
+			popped += static_cast<int>(count);
+		}
+
+		for (auto& producer : producers)
+			producer.join();
+
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("Unordered")
+	{
+		constexpr auto NUM_PRODUCERS = 4;
+		constexpr auto TEST_ITER = 10000;
+
+		MPSCQueue<int> queue(NUM_PRODUCERS, 64);
+		std::vector<std::thread> producers;
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+		{
+			producers.emplace_back([queue, pid]() mutable {
+				for (int i = 0; i < TEST_ITER; i++)
+				{
+					while (!queue.TryPush(pid, pid * TEST_ITER + i))
+						std::this_thread::yield();
+				}
+			});
+		}
+
+		// Elements of different producers may be reordered, but not of the same producer.
+		std::array<int, NUM_PRODUCERS> next = {};
+		int val;
+
+		for (int i = 0; i < NUM_PRODUCERS * TEST_ITER; i++)
+		{
+			while (!queue.TryPopUnordered(val))
+				std::this_thread::yield();
+
+			REQUIRE(val % TEST_ITER == next[val / TEST_ITER]++);
+		}
+
+		for (auto& producer : producers)
+			producer.join();
+
+		REQUIRE(queue.TryPopUnordered().has_value() == false);
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("Combined")
+	{
+		constexpr auto NUM_PRODUCERS = 4;
+		constexpr auto TEST_ITER = 10000;
+
+		MPSCQueue<int> queue(NUM_PRODUCERS, 16);
+		std::vector<std::thread> producers;
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+		{
+			producers.emplace_back([queue, pid]() mutable {
+				for (int i = 0; i < TEST_ITER; i++)
+				{
+					while (!queue.TryPushCombined(pid, pid * TEST_ITER + i))
+						std::this_thread::yield();
+				}
+			});
+		}
+
+		std::array<int, NUM_PRODUCERS> next = {};
+		int val;
+
+		for (int i = 0; i < NUM_PRODUCERS * TEST_ITER; i++)
+		{
+			while (!queue.TryPop(val))
+				std::this_thread::yield();
+
+			REQUIRE(val % TEST_ITER == next[val / TEST_ITER]++);
+		}
+
+		for (auto& producer : producers)
+			producer.join();
+
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("Unbounded")
+	{
+		constexpr auto SEGMENT_SIZE = 4;
+		constexpr auto TEST_ITER = 1000;
+
+		MPSCUnboundedQueue<int> queue(1, SEGMENT_SIZE);
+		int val;
+
+		// Never full, segments are linked as needed.
+		for (int i = 0; i < TEST_ITER; i++)
+			queue.Push(0, i);
+
+		for (int i = 0; i < TEST_ITER; i++)
+		{
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i);
+		}
+		REQUIRE(queue.TryPop(val) == false);
+		REQUIRE(queue.IsEmpty() == true);
+
+		const auto allocations = queue.SegmentAllocations();
+		REQUIRE(allocations >= TEST_ITER / SEGMENT_SIZE);
+		REQUIRE(queue.MemoryHighWater() != 0);
+
+		// Drained segments are reused.
+		for (int i = 0; i < TEST_ITER; i++)
+		{
+			queue.Push(0, i);
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i);
+		}
+		REQUIRE(queue.SegmentAllocations() == allocations);
+	}
+
+	TEST_CASE("UnboundedConcurrency")
+	{
+		constexpr auto NUM_PRODUCERS = 3;
+		constexpr auto TEST_ITER = 10000;
+
+		MPSCUnboundedQueue<int> queue(NUM_PRODUCERS, 16);
+		std::vector<std::thread> producers;
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+		{
+			producers.emplace_back([queue, pid]() mutable {
+				for (int i = 0; i < TEST_ITER; i++)
+					queue.Push(pid, pid * TEST_ITER + i);
+			});
+		}
+
+		std::array<int, NUM_PRODUCERS> next = {};
+		int val;
+
+		for (int i = 0; i < NUM_PRODUCERS * TEST_ITER; i++)
+		{
+			while (!queue.TryPop(val))
+				std::this_thread::yield();
+
+			REQUIRE(val % TEST_ITER == next[val / TEST_ITER]++);
+		}
+
+		for (auto& producer : producers)
+			producer.join();
+
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("Lanes")
+	{
+		constexpr auto NUM_PRODUCERS = 4;
+		constexpr auto TEST_ITER = 10000;
+
+		MPSCLaneQueue<int> queue(NUM_PRODUCERS, 16);
+		std::vector<std::thread> producers;
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+		{
+			producers.emplace_back([queue, pid]() mutable {
+				for (int i = 0; i < TEST_ITER;)
+				{
+					std::array<int, 3> vals = { pid * TEST_ITER + i, pid * TEST_ITER + i + 1,
+						pid * TEST_ITER + i + 2 };
+					const auto count = std::min<std::size_t>(vals.size(), TEST_ITER - i);
+
+					i += static_cast<int>(queue.TryPushN(pid, vals.data(), count));
+					if (queue.IsFull(pid))
+						std::this_thread::yield();
+				}
+			});
+		}
+
+		std::array<int, NUM_PRODUCERS> next = {};
+		std::array<int, 5> vals = {};
+
+		for (int popped = 0; popped < NUM_PRODUCERS * TEST_ITER;)
+		{
+			// Alternate single and batched pops, to cover switching lanes in between.
+			const auto count = popped % 2 == 0 ? queue.TryPop(vals[0]) ? 1 : 0
+											   : queue.TryPopN(vals.data(), vals.size());
+			if (count == 0)
+				std::this_thread::yield();
+
+			for (std::size_t i = 0; i < count; i++)
+				REQUIRE(vals[i] % TEST_ITER == next[vals[i] / TEST_ITER]++);
+
+			popped += static_cast<int>(count);
+		}
+
+		for (auto& producer : producers)
+			producer.join();
+
+		REQUIRE(queue.TryPop().has_value() == false);
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("SparseProducers")
+	{
+		constexpr auto MAX_PROCESSES = 1024;
+		constexpr auto TEST_ITER = 10000;
+		constexpr std::array<int, 3> PIDS = { 3, 700, MAX_PROCESSES - 1 };
+
+		// Only a few of the processes ever push, so the consumer tracks just those.
+		MPSCQueue<int> queue(MAX_PROCESSES, 100);
+		std::vector<std::thread> producers;
+
+		for (size_t i = 0; i < PIDS.size(); i++)
+		{
+			const auto first = static_cast<int>(i) * TEST_ITER;
+
+			producers.emplace_back([queue, pid = PIDS[i], first]() mutable {
+				for (int j = 0; j < TEST_ITER; j++)
+				{
+					while (!queue.TryPush(pid, first + j))
+						std::this_thread::yield();
+				}
+			});
+		}
+
+		std::array<int, PIDS.size()> next = {};
+		int val;
+
+		for (size_t i = 0; i < PIDS.size() * TEST_ITER; i++)
+		{
+			while (!queue.TryPop(val))
+				std::this_thread::yield();
+
+			REQUIRE(val % TEST_ITER == next[val / TEST_ITER]++);
+		}
+
+		for (auto& producer : producers)
+			producer.join();
+
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("PidLease")
+	{
+		MPSCQueue<int> queue(2, 4);
+
+		auto lease0 = lockfree::PidLease<MPSCQueue<int>>::Acquire(queue);
+		REQUIRE(lease0.has_value() == true);
+		{
+			auto lease1 = lockfree::PidLease<MPSCQueue<int>>::Acquire(queue);
+			REQUIRE(lease1.has_value() == true);
+			REQUIRE(lease1->Pid() != lease0->Pid());
+			REQUIRE(queue.AcquirePid().has_value() == false);
+		}
+
+		// Released pids are leased again.
+		auto pid = queue.AcquirePid();
+		REQUIRE(pid.has_value() == true);
+		REQUIRE(*pid != lease0->Pid());
+		queue.ReleasePid(*pid);
+	}
+
+	TEST_CASE("ThreadPid")
+	{
+		constexpr auto MAX_PROCESSES = 2;
+		constexpr auto NUM_ROUNDS = 4;
+
+		MPSCQueue<int> queue(MAX_PROCESSES, 100);
+		int val;
+
+		// More threads than pids, but never more than `MAX_PROCESSES` of them at once, as the
+		// threads release their pids when they exit.
+		for (int round = 0; round < NUM_ROUNDS; round++)
+		{
+			std::vector<std::thread> producers;
+
+			for (int i = 0; i < MAX_PROCESSES; i++)
+			{
+				producers.emplace_back([queue]() mutable {
+					auto pid = queue.ThreadPid();
+					REQUIRE(pid.has_value() == true);
+					REQUIRE(queue.ThreadPid() == pid);
+					REQUIRE(queue.TryPush(*pid, *pid) == true);
+				});
+			}
+
+			for (auto& producer : producers)
+				producer.join();
+
+			for (int i = 0; i < MAX_PROCESSES; i++)
+				REQUIRE(queue.TryPop(val) == true);
+		}
+
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("SeqBasic")
 	{
-		MPSCQueue<int> queue(1, 3);
+		MPSCSeqQueue<int> queue(1, 3);
 
-		REQUIRE(queue.TryPush(0, 1) == true);
-		REQUIRE(queue.TryPush(0, 2) == true);
-		REQUIRE(queue.TryPush(0, 3) == true);
+		for (int i = 0; i < 3; i++)
+		{
+			REQUIRE(queue.TryPush(0, i) == true);
+			REQUIRE(queue.TryPush(0, i + 1) == true);
+			REQUIRE(queue.TryPush(0, i + 2) == true);
+			REQUIRE(queue.TryPush(0, i + 3) == false);
+			REQUIRE(queue.IsFull() == true);
 
-		REQUIRE(queue.TryPush(0, 4) == false);
+			int val;
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i);
+			REQUIRE(queue.TryPeek(val) == true);
+			REQUIRE(val == i + 1);
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i + 1);
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i + 2);
+
+			REQUIRE(queue.TryPeek(val) == false);
+			REQUIRE(queue.TryPop(val) == false);
+			REQUIRE(queue.IsEmpty() == true);
+		}
+	}
+
+	TEST_CASE("SeqConcurrency")
+	{
+		constexpr auto NUM_PRODUCERS = 4;
+		constexpr auto TEST_ITER = 10000;
+
+		MPSCSeqQueue<int> queue(NUM_PRODUCERS, 100);
+		std::vector<std::thread> producers;
+
+		for (int pid = 0; pid < NUM_PRODUCERS; pid++)
+		{
+			producers.emplace_back([queue, pid]() mutable {
+				for (int i = 0; i < TEST_ITER; i++)
+				{
+					while (!queue.TryPush(pid, pid * TEST_ITER + i))
+						std::this_thread::yield();
+				}
+			});
+		}
 
+		// Every producer's elements are popped in the order it pushed them.
+		std::array<int, NUM_PRODUCERS> next = {};
 		int val;
-		REQUIRE(queue.TryPop(val) == true);
-		REQUIRE(val == 1);
-		REQUIRE(queue.TryPop(val) == true);
-		REQUIRE(val == 2);
-		REQUIRE(queue.TryPeek(val) == true);
-		REQUIRE(val == 3);
-		REQUIRE(queue.TryPop(val) == true);
-		REQUIRE(val == 3);
 
-		REQUIRE(queue.TryPeek(val) == false);
-		REQUIRE(queue.TryPop(val) == false);
+		for (int i = 0; i < NUM_PRODUCERS * TEST_ITER; i++)
+		{
+			while (!queue.TryPop(val))
+				std::this_thread::yield();
+
+			const auto pid = val / TEST_ITER;
+			REQUIRE(val % TEST_ITER == next[pid]++);
+		}
+
+		for (auto& producer : producers)
+			producer.join();
+
+		REQUIRE(queue.IsEmpty() == true);
 	}
 
 	void push(MPSCQueueAny queue, size_t count, int pid)
@@ -85,6 +1095,81 @@ TEST_SUITE("MPSC") // NOLINT
 		consumer.join();
 		producer.join();
 	}
+
+	TEST_CASE("MirroredWrapAround")
+	{
+		static constexpr auto QSIZE = StringGen::AVGLEN * 100;
+		constexpr auto TEST_ITER = 5000;
+
+		MPSCQueueAny queue(1, QSIZE, true);
+		std::thread consumer{ pop<MPSCQueueAny>, queue, TEST_ITER };
+		std::thread producer{ push, queue, TEST_ITER, 0 };
+
+		consumer.join();
+		producer.join();
+	}
+
+	TEST_CASE("FramingWrapAround")
+	{
+		using lockfree::Framing;
+
+		static constexpr auto QSIZE = StringGen::AVGLEN * 100;
+		constexpr auto TEST_ITER = 5000;
+
+		MPSCQueueAny queue(1, QSIZE, false, Framing(Framing::Header::U32, 16));
+		std::thread consumer{ pop<MPSCQueueAny>, queue, TEST_ITER };
+		std::thread producer{ push, queue, TEST_ITER, 0 };
+
+		consumer.join();
+		producer.join();
+	}
+
+	TEST_CASE("ReserveCommit")
+	{
+		static constexpr auto QSIZE = StringGen::AVGLEN * 10;
+		constexpr auto NUM_PRODUCERS = 2;
+		constexpr auto TEST_ITER = 2000;
+
+		MPSCQueueAny queue(NUM_PRODUCERS, QSIZE);
+
+		// Producers write straight into the ring buffer and the consumer reads from it in place.
+		auto produce = [queue](int pid) mutable {
+			StringGen str;
+
+			for (int i = 0; i < TEST_ITER; i++)
+			{
+				const auto data = str();
+				std::optional<MPSCQueueAny::WriteRegion> region;
+
+				while (!(region = queue.Reserve(pid, data.length())))
+					std::this_thread::yield();
+
+				std::memcpy(region->first, data.data(), region->first_size);
+				std::memcpy(region->second, data.data() + region->first_size, region->second_size);
+				queue.Commit(pid);
+			}
+		};
+
+		std::thread producer0{ produce, 0 };
+		std::thread producer1{ produce, 1 };
+
+		for (int i = 0; i < NUM_PRODUCERS * TEST_ITER; i++)
+		{
+			std::optional<MPSCQueueAny::ReadRegion> region;
+
+			while (!(region = queue.TryRead()))
+				std::this_thread::yield();
+
+			std::string data(region->first, region->first_size);
+			data.append(region->second, region->second_size);
+			REQUIRE(StringGen::Verify(data) == true);
+			queue.Consume();
+		}
+
+		producer0.join();
+		producer1.join();
+		REQUIRE(queue.IsEmpty() == true);
+	}
 }
 
 TEST_SUITE("SPSC") // NOLINT
@@ -113,6 +1198,324 @@ TEST_SUITE("SPSC") // NOLINT
 		REQUIRE(queue.TryPop(val) == false);
 	}
 
+	TEST_CASE("Fixed")
+	{
+		struct Stage
+		{
+			lockfree::fixed::SPSCQueue<int, 3> queue;
+		};
+
+		// Ring buffer lives inside the owning object.
+		Stage stage;
+		auto& queue = stage.queue;
+		static_assert(sizeof(Stage) >= 3 * sizeof(int));
+
+		for (int i = 0; i < 5; i++)
+		{
+			REQUIRE(queue.TryPush(i) == true);
+			REQUIRE(queue.TryPush(i + 1) == true);
+			REQUIRE(queue.TryPush(i + 2) == true);
+			REQUIRE(queue.TryPush(i + 3) == false);
+
+			int val;
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i);
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i + 1);
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i + 2);
+			REQUIRE(queue.TryPop(val) == false);
+		}
+	}
+
+	TEST_CASE("Batch")
+	{
+		SPSCQueue<int> queue(5);
+		std::array<int, 4> in = { 1, 2, 3, 4 };
+		std::array<int, 4> out = {};
+
+		REQUIRE(queue.TryPushN(in.data(), 3) == 3);
+		REQUIRE(queue.TryPopN(out.data(), 2) == 2);
+		REQUIRE(out[0] == 1);
+		REQUIRE(out[1] == 2);
+
+		// Wraps around the end of the ring, and is truncated to the free space.
+		REQUIRE(queue.TryPushN(in.begin(), in.end()) == 4);
+		REQUIRE(queue.TryPushN(in.begin(), in.end()) == 0);
+		REQUIRE(queue.IsFull() == true);
+
+		REQUIRE(queue.TryPopN(out.data(), 1) == 1);
+		REQUIRE(out[0] == 3);
+		REQUIRE(queue.TryPopN(out.data(), out.size()) == 4);
+		REQUIRE(out == in);
+
+		REQUIRE(queue.TryPopN(out.data(), out.size()) == 0);
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	struct Counted
+	{
+		static inline int alive = 0;
+
+		explicit Counted(int v) : val(v) { alive++; }
+		Counted(Counted&& other) noexcept : val(other.val) { alive++; }
+		Counted(const Counted&) = delete;
+		auto operator=(Counted&&) noexcept -> Counted& = default;
+		auto operator=(const Counted&) -> Counted& = delete;
+		~Counted() { alive--; }
+
+		int val;
+	};
+
+	TEST_CASE("NonTrivial")
+	{
+		SPSCQueue<std::unique_ptr<int>> queue(2);
+
+		REQUIRE(queue.TryEmplace(std::make_unique<int>(1)) == true);
+		REQUIRE(queue.TryPush(std::make_unique<int>(2)) == true);
+		REQUIRE(queue.TryPush(std::make_unique<int>(3)) == false);
+
+		auto elem = queue.TryPop();
+		REQUIRE(elem.has_value() == true);
+		REQUIRE(**elem == 1);
+		std::unique_ptr<int> outelem;
+		REQUIRE(queue.TryPop(outelem) == true);
+		REQUIRE(*outelem == 2);
+		REQUIRE(queue.IsEmpty() == true);
+
+		// Batches of strings, wrapping around the end of the ring buffer.
+		SPSCQueue<std::string> strings(3);
+		const std::array<std::string, 2> in = { std::string(64, 'a'), "b" };
+		std::array<std::string, 3> out;
+
+		REQUIRE(strings.TryPushN(in.begin(), in.end()) == 2);
+		REQUIRE(strings.TryPopN(out.begin(), 1) == 1);
+		REQUIRE(strings.TryPushN(in.begin(), in.end()) == 2);
+		REQUIRE(strings.TryPopN(out.begin(), out.size()) == 3);
+		REQUIRE(out == std::array<std::string, 3>{ in[1], in[0], in[1] });
+
+		// Elements left inside are destroyed along with the queue.
+		{
+			SPSCQueue<Counted> counted(4);
+
+			REQUIRE(counted.TryEmplace(1) == true);
+			REQUIRE(counted.TryEmplace(2) == true);
+			REQUIRE(counted.TryEmplace(3) == true);
+			REQUIRE(counted.TryPop()->val == 1);
+			REQUIRE(Counted::alive == 2);
+		}
+		REQUIRE(Counted::alive == 0);
+	}
+
+	TEST_CASE("DeferredPublication")
+	{
+		constexpr auto PUBLISH_BATCH = 4;
+
+		SPSCQueue<int> queue(8, PUBLISH_BATCH);
+		int val = 0;
+
+		// Pushes become visible once `PUBLISH_BATCH` of them are pending.
+		REQUIRE(queue.TryPush(1) == true);
+		REQUIRE(queue.TryPush(2) == true);
+		REQUIRE(queue.TryPush(3) == true);
+		REQUIRE(queue.IsEmpty() == true);
+		REQUIRE(queue.TryPush(4) == true);
+		REQUIRE(queue.IsEmpty() == false);
+
+		for (int i = 1; i <= 4; i++)
+		{
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i);
+		}
+
+		// Or when flushed.
+		REQUIRE(queue.TryPush(5) == true);
+		REQUIRE(queue.IsEmpty() == true);
+		queue.Flush();
+		REQUIRE(queue.TryPop(val) == true);
+		REQUIRE(val == 5);
+
+		// Or right away, when the consumer found the queue empty.
+		REQUIRE(queue.TryPop(val) == false);
+		REQUIRE(queue.TryPush(6) == true);
+		REQUIRE(queue.TryPop(val) == true);
+		REQUIRE(val == 6);
+
+		// Pops are published right away, once the producer found the queue full.
+		int pushed = 7;
+		while (queue.TryPush(pushed))
+			pushed++;
+
+		REQUIRE(queue.TryPop(val) == true);
+		REQUIRE(val == 7);
+		REQUIRE(queue.TryPush(pushed) == true);
+		queue.Flush();
+
+		for (int i = 8; i <= pushed; i++)
+		{
+			REQUIRE(queue.TryPop(val) == true);
+			REQUIRE(val == i);
+		}
+		REQUIRE(queue.TryPop(val) == false);
+	}
+
+	TEST_CASE("AnyBasic")
+	{
+		constexpr auto QLEN = 2 * sizeof(SPSCQueueAny::size_type) + 5;
+
+		constexpr std::string_view DATA1 = { "ab" };
+		constexpr std::string_view DATA2 = { "abc" };
+
+		SPSCQueueAny queue(QLEN);
+
+		REQUIRE(queue.TryPush(DATA1) == true);
+		REQUIRE(queue.TryPush(DATA2) == true);
+		REQUIRE(queue.TryPush(DATA1) == false);
+
+		std::array<char, QLEN> outdata = {};
+
+		REQUIRE(queue.TryPeek(outdata.data()) == true);
+		REQUIRE(outdata.data() == DATA1);
+		REQUIRE(queue.TryPop(outdata.data()) == true);
+		REQUIRE(outdata.data() == DATA1);
+
+		// Space freed by the consumer becomes visible to the producer.
+		REQUIRE(queue.TryPush(DATA1) == true);
+
+		outdata = {};
+		REQUIRE(queue.TryPop(outdata.data()) == true);
+		REQUIRE(outdata.data() == DATA2);
+		outdata = {};
+		REQUIRE(queue.TryPop(outdata.data()) == true);
+		REQUIRE(outdata.data() == DATA1);
+		REQUIRE(queue.TryPop(outdata.data()) == false);
+	}
+
+	TEST_CASE("ReserveCommit")
+	{
+		constexpr auto QLEN = 2 * sizeof(SPSCQueueAny::size_type) + 8;
+
+		constexpr std::string_view DATA1 = { "abcdef" };
+		constexpr std::string_view DATA2 = { "xyz" };
+
+		SPSCQueueAny queue(QLEN);
+		std::array<char, QLEN> outdata = {};
+
+		auto write = [](SPSCQueueAny::WriteRegion region, std::string_view data) {
+			const auto len = std::min(region.first_size, data.length());
+
+			std::memcpy(region.first, data.data(), len);
+			std::memcpy(region.second, data.data() + len, data.length() - len);
+		};
+
+		REQUIRE(queue.Reserve(QLEN).has_value() == false);
+
+		auto region = queue.Reserve(DATA1.length() + 2);
+		REQUIRE(region.has_value() == true);
+		REQUIRE(region->second_size == 0);
+		write(*region, DATA1);
+		queue.Commit(DATA1.length());
+
+		region = queue.Reserve(1);
+		REQUIRE(region.has_value() == true);
+		queue.Abort();
+		REQUIRE(queue.TryPop(outdata.data()) == true);
+		REQUIRE(outdata.data() == DATA1);
+		REQUIRE(queue.TryPop(outdata.data()) == false);
+
+		// Wraps around the end of the ring buffer.
+		region = queue.Reserve(DATA2.length());
+		REQUIRE(region.has_value() == true);
+		REQUIRE(region->size() == DATA2.length());
+		REQUIRE(region->second_size != 0);
+		write(*region, DATA2);
+		queue.Commit(DATA2.length());
+
+		outdata = {};
+		REQUIRE(queue.TryPop(outdata.data()) == true);
+		REQUIRE(outdata.data() == DATA2);
+	}
+
+	TEST_CASE("ReadConsume")
+	{
+		constexpr auto QLEN = 2 * sizeof(SPSCQueueAny::size_type) + 8;
+
+		constexpr std::string_view DATA1 = { "abcdef" };
+		constexpr std::string_view DATA2 = { "xyz" };
+
+		SPSCQueueAny queue(QLEN);
+
+		auto read = [](SPSCQueueAny::ReadRegion region) {
+			std::string data(region.first, region.first_size);
+			return data.append(region.second, region.second_size);
+		};
+
+		REQUIRE(queue.TryRead().has_value() == false);
+
+		REQUIRE(queue.TryPush(DATA1) == true);
+		auto region = queue.TryRead();
+		REQUIRE(region.has_value() == true);
+		REQUIRE(region->second_size == 0);
+		REQUIRE(read(*region) == DATA1);
+		queue.Consume();
+		REQUIRE(queue.TryRead().has_value() == false);
+
+		// Wraps around the end of the ring buffer.
+		REQUIRE(queue.TryPush(DATA2) == true);
+		region = queue.TryRead();
+		REQUIRE(region.has_value() == true);
+		REQUIRE(region->second_size != 0);
+		REQUIRE(read(*region) == DATA2);
+		queue.Consume();
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
+	TEST_CASE("Framing")
+	{
+		using lockfree::Framing;
+
+		constexpr std::string_view DATA1 = { "ab" };
+		constexpr std::string_view DATA2 = { "abc" };
+
+		// 32-bit headers pack tighter than the default ones.
+		SPSCQueueAny compact(2 * sizeof(std::uint32_t) + 5, false, Framing(Framing::Header::U32));
+
+		REQUIRE(compact.TryPush(DATA1) == true);
+		REQUIRE(compact.TryPush(DATA2) == true);
+		REQUIRE(compact.TryPush(DATA1) == false);
+
+		// Every payload starts at a multiple of `ALIGN`, with its header right before it.
+		constexpr auto ALIGN = 16;
+		constexpr std::string_view DATA3 = { "abcdefghijkl" };
+
+		SPSCQueueAny queue(4 * ALIGN, false, Framing(Framing::Header::U32, ALIGN));
+
+		auto read = [&] {
+			auto region = queue.TryRead();
+			REQUIRE(region.has_value() == true);
+			REQUIRE(reinterpret_cast<std::uintptr_t>(region->first) % ALIGN == 0);
+			REQUIRE(region->second_size == 0);
+
+			std::string data(region->first, region->first_size);
+			queue.Consume();
+			return data;
+		};
+
+		REQUIRE(queue.TryPush(DATA3) == true);
+		REQUIRE(queue.TryPush(DATA3) == true);
+		REQUIRE(queue.TryPush(DATA3) == true);
+		REQUIRE(queue.TryPush(DATA3) == false);
+
+		REQUIRE(read() == DATA3);
+		REQUIRE(read() == DATA3);
+
+		// Header is at the end of the ring buffer and the payload at its start.
+		REQUIRE(queue.TryPush(DATA2) == true);
+		REQUIRE(read() == DATA3);
+		REQUIRE(read() == DATA2);
+		REQUIRE(queue.IsEmpty() == true);
+	}
+
 	void push(SPSCQueueAny queue, size_t count)
 	{
 		StringGen str;
@@ -137,6 +1540,51 @@ TEST_SUITE("SPSC") // NOLINT
 		consumer.join();
 		producer.join();
 	}
+
+	TEST_CASE("DeferredPublicationWrapAround")
+	{
+		static constexpr auto QSIZE = StringGen::AVGLEN * 100;
+		constexpr auto TEST_ITER = 5000;
+		constexpr auto PUBLISH_BATCH = 16;
+
+		SPSCQueueAny queue(QSIZE, false, {}, PUBLISH_BATCH);
+		std::thread consumer{ pop<SPSCQueueAny>, queue, TEST_ITER };
+		std::thread producer{ [queue]() mutable {
+			push(queue, TEST_ITER);
+			queue.Flush();
+		} };
+
+		consumer.join();
+		producer.join();
+	}
+
+	TEST_CASE("MirroredWrapAround")
+	{
+		static constexpr auto QSIZE = StringGen::AVGLEN * 100;
+		constexpr auto TEST_ITER = 5000;
+
+		SPSCQueueAny queue(QSIZE, true);
+		StringGen str;
+
+		// Elements crossing the end of the ring buffer are still read in one piece.
+		for (int i = 0; i < TEST_ITER; i++)
+		{
+			auto data = str();
+			REQUIRE(queue.TryPush(data) == true);
+
+			auto region = queue.TryRead();
+			REQUIRE(region.has_value() == true);
+			REQUIRE(region->second_size == 0);
+			REQUIRE(std::string_view(region->first, region->first_size) == data);
+			queue.Consume();
+		}
+
+		std::thread consumer{ pop<SPSCQueueAny>, queue, TEST_ITER };
+		std::thread producer{ push, queue, TEST_ITER };
+
+		consumer.join();
+		producer.join();
+	}
 }
 
 TEST_SUITE("MPSC-PC") // NOLINT
@@ -205,6 +1653,31 @@ TEST_SUITE("MPSC-PC") // NOLINT
 
 	static constexpr auto QSIZE = StringGen::AVGLEN * 100;
 
+	TEST_CASE("PowerOfTwoWrapAround")
+	{
+		constexpr auto QSIZE_POW2 = lockfree::PowerOfTwoCapacity::RoundUp(QSIZE);
+		constexpr auto TEST_ITER = 5000;
+
+		MPSCPCQueueAny queue(QSIZE_POW2);
+		std::thread consumer{ pop<MPSCPCQueueAny>, queue, TEST_ITER };
+		std::thread producer{ push, queue, TEST_ITER };
+
+		consumer.join();
+		producer.join();
+	}
+
+	TEST_CASE("MirroredWrapAround")
+	{
+		constexpr auto TEST_ITER = 5000;
+
+		MPSCPCQueueAny queue(QSIZE, true);
+		std::thread consumer{ pop<MPSCPCQueueAny>, queue, TEST_ITER };
+		std::thread producer{ push, queue, TEST_ITER };
+
+		consumer.join();
+		producer.join();
+	}
+
 	TEST_CASE("ThreadMigration")
 	{
 		constexpr auto TEST_ITER = 5000;